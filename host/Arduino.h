@@ -0,0 +1,333 @@
+// ============================================================================
+// HOST ARDUINO CORE SHIM
+// Lets generated sketches build as native Linux programs. Time is virtual:
+// every API call advances a simulated clock by an estimate of what it costs
+// on a 16 MHz AVR, and each call is counted so codegen changes can be
+// compared by how much work the sketch really does.
+// ============================================================================
+#ifndef ARDUINO_HOST_H
+#define ARDUINO_HOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define HOST_CPU_HZ 16000000UL
+#define HOST_MAX_PINS 70
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef bit
+#define bit(n) (1UL << (n))
+#endif
+
+#ifndef constrain
+#define constrain(amount, low, high) ((amount) < (low) ? (low) : ((amount) > (high) ? (high) : (amount)))
+#endif
+
+// Thrown when the virtual time budget runs out (e.g. inside a forever block)
+struct HostStop {};
+
+enum HostApi {
+    API_PIN_MODE, API_DIGITAL_WRITE, API_DIGITAL_READ, API_ANALOG_READ, API_ANALOG_WRITE,
+    API_DELAY, API_DELAY_MICROSECONDS, API_MILLIS, API_MICROS, API_TONE, API_PULSE_IN,
+    API_SERIAL, API_SERVO, API_LCD, API_DHT,
+    API_COUNT
+};
+
+static const char* const host_api_names[API_COUNT] = {
+    "pinMode", "digitalWrite", "digitalRead", "analogRead", "analogWrite",
+    "delay", "delayMicroseconds", "millis", "micros", "tone", "pulseIn",
+    "Serial", "Servo", "LiquidCrystal", "DHT"
+};
+
+struct HostState {
+    uint64_t now_us = 0;                        // Virtual clock
+    uint64_t limit_us = 60000000ULL;            // Stop the sketch after this much virtual time
+    uint64_t busy_cycles = 0;                   // CPU cycles spent outside delay()
+    uint64_t calls[API_COUNT] = {};
+    uint64_t cycles[API_COUNT] = {};
+    uint64_t serial_bytes = 0;
+    uint64_t serial_tx_free_us = 0;             // When the TX buffer will have drained
+    unsigned long baud = 9600;
+    int echo_serial = 0;
+    int pin_modes[HOST_MAX_PINS] = {};
+    int pin_levels[HOST_MAX_PINS] = {};
+    unsigned long echo_us = 1160;               // Simulated ultrasonic echo length
+    float temperature = 22.5f;                  // Simulated DHT reading
+    uint64_t echo_rise_us = 0;                  // Pending echo edges after a trigger, 0 = none
+    uint64_t echo_fall_us = 0;
+    int in_interrupt = 0;
+    int interrupts_off = 0;
+    int pcint_pending = 0;                      // An edge arrived with interrupts off
+    uint64_t interrupts_off_us = 0;             // When noInterrupts() was called
+    uint64_t pin_low_us[HOST_MAX_PINS] = {};    // When an output was last driven LOW
+    uint64_t dht_start_us[HOST_MAX_PINS] = {};  // Start of a simulated DHT22 reply, 0 = none
+};
+
+inline HostState host;
+
+// Pin-change interrupts: every pin is in group 0 and raises PCINT0_vect
+#define PCINT0_vect PCINT0_vect
+#define ISR(vector) void vector()
+extern void PCINT0_vect() __attribute__((weak));
+
+inline volatile uint8_t PCICR = 0;
+inline volatile uint8_t PCIFR = 0;
+inline volatile uint8_t host_pcmsk[HOST_MAX_PINS / 8 + 1];
+#define digitalPinToPCMSK(pin) (&host_pcmsk[(pin) / 8])
+#define digitalPinToPCMSKbit(pin) ((pin) % 8)
+#define digitalPinToPCICRbit(pin) 0
+
+// Timer0 overflows every 1024 us and its ISR keeps millis()/micros(). With
+// interrupts off millis() stops, and micros() only adds the one pending
+// overflow, so after two missed overflows it jumps back 1024 us each time.
+#define HOST_TIMER0_OVERFLOW_US 1024
+
+inline void noInterrupts() {
+    if (!host.interrupts_off) host.interrupts_off_us = host.now_us;
+    host.interrupts_off = 1;
+}
+
+inline void host_run_pcint() {
+    host.pcint_pending = 0;
+    if (PCINT0_vect && PCICR) {
+        host.in_interrupt = 1;
+        PCINT0_vect();
+        host.in_interrupt = 0;
+    }
+}
+
+inline void interrupts() {
+    host.interrupts_off = 0;
+    if (host.pcint_pending) host_run_pcint();
+}
+
+inline uint64_t host_micros_now() {
+    if (!host.interrupts_off) return host.now_us;
+    uint64_t counted = host.interrupts_off_us - host.interrupts_off_us % HOST_TIMER0_OVERFLOW_US;
+    uint64_t elapsed = host.now_us - counted;
+    if (elapsed < 2 * HOST_TIMER0_OVERFLOW_US) return host.now_us;
+    return counted + HOST_TIMER0_OVERFLOW_US + elapsed % HOST_TIMER0_OVERFLOW_US;
+}
+
+// Called by delay() while it waits, like the AVR core
+void yield();
+
+// Drive every pin-change-enabled input to level and run the ISR
+inline void host_echo_edge(int level) {
+    for (int pin = 0; pin < HOST_MAX_PINS; pin++) {
+        if ((host_pcmsk[pin / 8] & bit(pin % 8)) && host.pin_modes[pin] != OUTPUT) {
+            host.pin_levels[pin] = level;
+        }
+    }
+    if (host.interrupts_off) {
+        host.pcint_pending = 1;         // Runs once interrupts() is called, like PCIFR
+    } else {
+        host_run_pcint();
+    }
+}
+
+// Move the clock forward, firing echo edges at their exact time on the way
+inline void host_advance(uint64_t us) {
+    uint64_t target = host.now_us + us;
+    if (!host.in_interrupt) {
+        if (host.echo_rise_us && target >= host.echo_rise_us) {
+            host.now_us = host.echo_rise_us > host.now_us ? host.echo_rise_us : host.now_us;
+            host.echo_rise_us = 0;
+            host_echo_edge(HIGH);
+        }
+        if (host.echo_fall_us && target >= host.echo_fall_us) {
+            host.now_us = host.echo_fall_us > host.now_us ? host.echo_fall_us : host.now_us;
+            host.echo_fall_us = 0;
+            host_echo_edge(LOW);
+        }
+    }
+    host.now_us = target > host.now_us ? target : host.now_us;
+    if (host.now_us > host.limit_us && !host.in_interrupt) throw HostStop();
+}
+
+// Charge a call: busy cycles advance the clock, idle_us is time spent waiting
+inline void host_charge(HostApi api, uint64_t cycles, uint64_t idle_us = 0) {
+    host.calls[api]++;
+    host.cycles[api] += cycles;
+    host.busy_cycles += cycles;
+    host_advance(cycles * 1000000ULL / HOST_CPU_HZ + idle_us);
+}
+
+// DHT22 reply to a start signal: 80 us LOW, 80 us HIGH, then 40 bits of
+// 50 us LOW + 27 us (0) or 70 us (1) HIGH, humidity then temperature in tenths
+inline int host_dht_level(uint8_t pin) {
+    uint64_t t = host.now_us - host.dht_start_us[pin];
+    int16_t tenths = (int16_t)lroundf(host.temperature * 10);
+    uint16_t raw = tenths < 0 ? (uint16_t)(0x8000 | -tenths) : (uint16_t)tenths;
+    uint8_t data[5] = { 0x01, 0xC2, (uint8_t)(raw >> 8), (uint8_t)raw, 0 };   // 45.0 %RH
+    data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+    
+    if (t < 30) return HIGH;            // Pull-up before the sensor answers
+    t -= 30;
+    if (t < 80) return LOW;
+    t -= 80;
+    if (t < 80) return HIGH;
+    t -= 80;
+    for (int i = 0; i < 40; i++) {
+        uint64_t high = (data[i / 8] & (0x80 >> (i % 8))) ? 70 : 27;
+        if (t < 50) return LOW;
+        t -= 50;
+        if (t < high) return HIGH;
+        t -= high;
+    }
+    if (t < 50) return LOW;
+    host.dht_start_us[pin] = 0;         // Reply done, the line idles HIGH
+    return HIGH;
+}
+
+// An output held LOW for a millisecond and then released is a DHT start signal
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < HOST_MAX_PINS) {
+        if (mode != OUTPUT && host.pin_modes[pin] == OUTPUT && host.pin_levels[pin] == LOW &&
+            host.now_us - host.pin_low_us[pin] >= 1000) {
+            host.dht_start_us[pin] = host.now_us;
+        }
+        host.pin_modes[pin] = mode;
+    }
+    host_charge(API_PIN_MODE, 60);
+}
+
+// A HIGH -> LOW edge on an output is taken as an ultrasonic trigger
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    if (pin < HOST_MAX_PINS) {
+        if (host.pin_levels[pin] == HIGH && !level && host.pin_modes[pin] == OUTPUT && host.echo_us) {
+            host.echo_rise_us = host.now_us + 200;
+            host.echo_fall_us = host.echo_rise_us + host.echo_us;
+        }
+        if (level == LOW && host.pin_levels[pin] != LOW) host.pin_low_us[pin] = host.now_us;
+        host.pin_levels[pin] = level ? HIGH : LOW;
+    }
+    host_charge(API_DIGITAL_WRITE, 70);
+}
+
+inline int digitalRead(uint8_t pin) {
+    host_charge(API_DIGITAL_READ, 60);
+    if (pin < HOST_MAX_PINS && host.dht_start_us[pin]) return host_dht_level(pin);
+    return pin < HOST_MAX_PINS ? host.pin_levels[pin] : LOW;
+}
+
+inline int analogRead(uint8_t pin) {
+    (void)pin;
+    host_charge(API_ANALOG_READ, 1700);  // ~104 us conversion
+    return 512;
+}
+
+inline void analogWrite(uint8_t pin, int value) {
+    if (pin < HOST_MAX_PINS) host.pin_levels[pin] = value;
+    host_charge(API_ANALOG_WRITE, 90);
+}
+
+inline void delay(unsigned long ms) {
+    host_charge(API_DELAY, 20);
+    for (unsigned long i = 0; i < ms; i++) {
+        host_advance(1000);
+        yield();
+    }
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    host_charge(API_DELAY_MICROSECONDS, 10, us);
+}
+
+inline unsigned long millis() {
+    host_charge(API_MILLIS, 30);
+    return (unsigned long)((host.interrupts_off ? host.interrupts_off_us : host.now_us) / 1000);
+}
+
+inline unsigned long micros() {
+    host_charge(API_MICROS, 50);
+    return (unsigned long)host_micros_now();
+}
+
+inline void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0) {
+    (void)pin; (void)frequency; (void)duration;
+    host_charge(API_TONE, 400);
+}
+
+inline void noTone(uint8_t pin) {
+    (void)pin;
+    host_charge(API_TONE, 100);
+}
+
+inline unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000UL) {
+    (void)pin; (void)state;
+    unsigned long wait = host.echo_us ? host.echo_us : timeout;
+    host_charge(API_PULSE_IN, 200, wait);
+    return host.echo_us;
+}
+
+// Serial: bytes queue into a 64-byte TX buffer that drains at the baud rate.
+// A write that finds the buffer full blocks until there is room, like the AVR core.
+class HostSerial {
+public:
+    void begin(unsigned long baud) {
+        host.baud = baud;
+        host_charge(API_SERIAL, 200);
+    }
+    
+    size_t write(uint8_t value) { return write(&value, 1); }
+    
+    size_t write(const uint8_t* data, size_t length) {
+        uint64_t byte_us = 10000000ULL / host.baud;
+        uint64_t idle_us = 0;
+        for (size_t i = 0; i < length; i++) {
+            uint64_t now = host.now_us + idle_us;
+            if (host.serial_tx_free_us < now) host.serial_tx_free_us = now;
+            uint64_t backlog_us = host.serial_tx_free_us - now;
+            if (backlog_us > 64 * byte_us) idle_us += backlog_us - 64 * byte_us;
+            host.serial_tx_free_us += byte_us;
+        }
+        host.serial_bytes += length;
+        if (host.echo_serial) fwrite(data, 1, length, stdout);
+        host_charge(API_SERIAL, 40 + 20 * length, idle_us);
+        return length;
+    }
+    
+    size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    size_t print(char value) { return write((uint8_t)value); }
+    size_t print(int value) { return print_format("%d", value); }
+    size_t print(unsigned int value) { return print_format("%u", value); }
+    size_t print(long value) { return print_format("%ld", value); }
+    size_t print(unsigned long value) { return print_format("%lu", value); }
+    size_t print(double value) { return print_format("%.2f", value); }
+    
+    template <typename T>
+    size_t println(T value) { return print(value) + print("\r\n"); }
+    size_t println() { return print("\r\n"); }
+    
+    operator bool() { return true; }
+
+private:
+    size_t print_format(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[32];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return write((const uint8_t*)buffer, (size_t)length);
+    }
+};
+
+inline HostSerial Serial;
+
+void setup();
+void loop();
+
+#endif
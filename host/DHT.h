@@ -0,0 +1,28 @@
+// Host shim for the Adafruit DHT sensor library (see Arduino.h)
+#ifndef DHT_HOST_H
+#define DHT_HOST_H
+
+#include "Arduino.h"
+
+#define DHT11 11
+#define DHT22 22
+
+class DHT {
+public:
+    DHT(uint8_t pin, uint8_t type) { (void)pin; (void)type; }
+    
+    void begin() { host_charge(API_DHT, 100); }
+    
+    // A DHT22 transaction holds the sketch for ~250 ms
+    float readTemperature() {
+        host_charge(API_DHT, 4000, 250000);
+        return host.temperature;
+    }
+    
+    float readHumidity() {
+        host_charge(API_DHT, 4000, 250000);
+        return 45.0f;
+    }
+};
+
+#endif
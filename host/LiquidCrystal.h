@@ -0,0 +1,32 @@
+// Host shim for the LiquidCrystal library (see Arduino.h)
+#ifndef LIQUID_CRYSTAL_HOST_H
+#define LIQUID_CRYSTAL_HOST_H
+
+#include "Arduino.h"
+
+class LiquidCrystal {
+public:
+    LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+        (void)rs; (void)enable; (void)d4; (void)d5; (void)d6; (void)d7;
+    }
+    
+    void begin(uint8_t columns, uint8_t rows) {
+        (void)columns; (void)rows;
+        host_charge(API_LCD, 800, 50000);
+    }
+    
+    void clear() { host_charge(API_LCD, 300, 2000); }
+    void setCursor(uint8_t column, uint8_t row) { (void)column; (void)row; host_charge(API_LCD, 300, 40); }
+    
+    // Each character is one 4-bit transfer plus the controller's ~40 us settle time
+    size_t print(const char* text) {
+        size_t length = strlen(text);
+        host_charge(API_LCD, 300 * length, 40 * length);
+        return length;
+    }
+    size_t print(int value) { char buffer[16]; snprintf(buffer, sizeof(buffer), "%d", value); return print(buffer); }
+    size_t print(long value) { char buffer[24]; snprintf(buffer, sizeof(buffer), "%ld", value); return print(buffer); }
+    size_t print(double value) { char buffer[32]; snprintf(buffer, sizeof(buffer), "%.2f", value); return print(buffer); }
+};
+
+#endif
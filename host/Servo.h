@@ -0,0 +1,29 @@
+// Host shim for the Servo library (see Arduino.h)
+#ifndef SERVO_HOST_H
+#define SERVO_HOST_H
+
+#include "Arduino.h"
+
+class Servo {
+public:
+    uint8_t attach(int pin) {
+        pin_ = pin;
+        host_charge(API_SERVO, 150);
+        return 0;
+    }
+    
+    void write(int angle) {
+        angle_ = constrain(angle, 0, 180);
+        host_charge(API_SERVO, 120);
+    }
+    
+    int read() { return angle_; }
+    bool attached() { return pin_ >= 0; }
+    void detach() { pin_ = -1; }
+
+private:
+    int pin_ = -1;
+    int angle_ = 90;
+};
+
+#endif
@@ -0,0 +1,46 @@
+// ============================================================================
+// HOST SKETCH RUNNER
+// Links against a generated sketch built with host/Arduino.h:
+//   c++ -std=c++17 -Ihost -include Arduino.h -x c++ sketch.ino -x none host/host_main.cpp
+// Runs setup() and N loop() iterations on the virtual clock, then reports
+// call counts and simulated cycles per Arduino API.
+//   ./sketch [loops] [--echo]
+// ============================================================================
+#include "Arduino.h"
+
+// Sketches that need background work during delay() define their own
+__attribute__((weak)) void yield() {}
+
+int main(int argc, char* argv[]) {
+    long loops = 10;
+    int completed = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--echo") == 0) {
+            host.echo_serial = 1;
+        } else {
+            loops = atol(argv[i]);
+        }
+    }
+    
+    try {
+        setup();
+        for (; completed < loops; completed++) {
+            loop();
+        }
+    } catch (const HostStop&) {
+        // Virtual time budget used up, usually a forever block
+    }
+    
+    printf("loops completed: %d of %ld\n", completed, loops);
+    printf("virtual time: %.3f s\n", host.now_us / 1000000.0);
+    printf("busy cycles: %llu\n", (unsigned long long)host.busy_cycles);
+    printf("serial bytes: %llu at %lu baud\n", (unsigned long long)host.serial_bytes, host.baud);
+    printf("%-18s %10s %14s\n", "api", "calls", "cycles");
+    for (int api = 0; api < API_COUNT; api++) {
+        if (host.calls[api] == 0) continue;
+        printf("%-18s %10llu %14llu\n", host_api_names[api],
+               (unsigned long long)host.calls[api], (unsigned long long)host.cycles[api]);
+    }
+    return 0;
+}
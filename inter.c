@@ -3,6 +3,19 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
 
 // ============================================================================
 // ARDUINO KIDS PROGRAMMING LANGUAGE INTERPRETER
@@ -28,13 +41,14 @@ typedef enum {
     TOKEN_BEEP, TOKEN_PLAY_TONE, TOKEN_PLAY_MELODY,
     
     // Motor Commands
-    TOKEN_MOTOR_FORWARD, TOKEN_MOTOR_BACKWARD, TOKEN_MOTOR_STOP,
+    TOKEN_MOTOR, TOKEN_MOTOR_FORWARD, TOKEN_MOTOR_BACKWARD, TOKEN_MOTOR_STOP,
     
     // Display Commands
     TOKEN_PRINT_LCD, TOKEN_CLEAR_LCD, TOKEN_PRINT_SERIAL,
     
     // Control Flow
     TOKEN_WAIT, TOKEN_REPEAT, TOKEN_IF, TOKEN_WHILE, TOKEN_FOREVER,
+    TOKEN_DEFINE, TOKEN_DO,
     
     // Comparison
     TOKEN_GREATER, TOKEN_LESS, TOKEN_EQUALS, TOKEN_NOT_EQUALS,
@@ -65,36 +79,145 @@ typedef struct {
     char* input;
     int pos;
     int length;
-    int line;
+    int line;           // Line and column of synced_pos, computed lazily
     int column;
+    int line_start;     // Offset of the first character on that line
+    int synced_pos;
     int error_count;
-    char errors[20][512];
+    char errors[20][576];    // "Line n, Col n: " + a message of up to 512 bytes
 } Lexer;
 
+// Known level of every output pin at the current point of the generated code
+#define PIN_STATE_COUNT 70          // Enough for an Arduino Mega
+#define PIN_LOW 0
+#define PIN_HIGH 1
+#define PIN_UNKNOWN -1
+
+typedef struct {
+    signed char level[PIN_STATE_COUNT];
+} PinLevels;
+
+// Code generation options chosen on the command line
+typedef struct {
+    int profile;            // Wrap statements in micros() timing, stream samples over Serial
+    int binary_log;         // Replace Serial text messages with compact binary records
+    int baud_rate;          // 0 picks 9600, or 115200 when a binary stream is enabled
+    int temp_interval_ms;   // Minimum time between temperature reads, 0 = DHT22's 2 s
+    int distance_interval_ms;   // Minimum time between pings of one distance sensor
+    int fixed_point;        // Integer-only sensor math: millimetres and tenths of a degree
+    int motor_ramp_ms;      // Time for a motor to go from stopped to full speed, 0 = 400 ms
+} CompileOptions;
+
+CompileOptions compile_options = {0};
+
+#define LOG_MAX_MESSAGES 128
+#define MAX_SONARS 6
+#define MAX_TEMP_SENSORS 4
+#define SONAR_SLOT_MS 40            // Longer than a no-echo pulse (~38 ms)
+#define DEFAULT_TEMP_INTERVAL_MS 2000
+#define MAX_MOTORS 4
+#define MOTOR_RAMP_MS 10            // Speed ramps are stepped this often
+#define DEFAULT_MOTOR_RAMP_MS 400
+#define MAX_PROCEDURES 32
+#define MAX_PROCEDURE_PARAMS 4
+
+// User-defined procedure (define name [params] { ... }), compiled to proc_<name>()
+typedef struct {
+    char name[64];
+    char params[MAX_PROCEDURE_PARAMS][64];
+    int param_count;
+    int defined;
+    int call_arity;         // Arity of the first call, checked once the define is seen
+    int call_line;
+    int call_column;
+} Procedure;
+
+// H-bridge motor (motor name <enable> <in1> <in2>), index = motor number
+typedef struct {
+    char name[64];
+    int enable_pin;         // PWM speed
+    int in1_pin;            // Direction: in1 HIGH = forward, in2 HIGH = backward
+    int in2_pin;
+    int line;
+    int column;
+} Motor;
+
+// One entry of the --binary-log string table; the record's value is printed
+// between prefix and suffix, divided by scale
 typedef struct {
-    char output[16384];
-    char setup_code[4096];
-    char loop_code[8192];
-    char includes[1024];
-    char globals[2048];
+    char prefix[272];       // Longest text: "📺 LCD: " (9 bytes) and a 255-byte string
+    char suffix[32];
+    int has_value;
+    int scale;
+} LogMessage;
+
+// Sections of the generated sketch. output holds all of them plus one
+// prototype per procedure, so assembling it can never overflow.
+#define SETUP_CODE_SIZE 4096
+#define LOOP_CODE_SIZE 16384        // Room for --profile's timing wrapper around every statement
+#define INCLUDES_SIZE 1024
+#define GLOBALS_SIZE 8192
+#define FUNCTIONS_SIZE 16384        // Bodies of user-defined procedures
+#define SIGNATURE_SIZE 512
+#define SKETCH_SIZE (INCLUDES_SIZE + GLOBALS_SIZE + MAX_PROCEDURES * (SIGNATURE_SIZE + 2) + 1 + \
+                     FUNCTIONS_SIZE + SETUP_CODE_SIZE + LOOP_CODE_SIZE)
+
+typedef struct {
+    char output[SKETCH_SIZE];
+    char setup_code[SETUP_CODE_SIZE];
+    char loop_code[LOOP_CODE_SIZE];
+    char includes[INCLUDES_SIZE];
+    char globals[GLOBALS_SIZE];
+    char functions[FUNCTIONS_SIZE];
+    char* code;             // Where statements are emitted: loop_code or functions
+    Procedure procedures[MAX_PROCEDURES];
+    int procedure_count;
+    Procedure* current_procedure;
+    CompileOptions options;
     int indent_level;
     int has_servo;
     int has_lcd;
-    int has_temperature;
-    int has_ultrasonic;
+    int temp_pins[MAX_TEMP_SENSORS];    // DHT sensors, index = sensor number
+    int temp_count;
+    int sonar_trig[MAX_SONARS];     // Ultrasonic sensors, index = sonar number
+    int sonar_echo[MAX_SONARS];
+    int sonar_line[MAX_SONARS];     // Where each sensor was first read, for errors
+    int sonar_column[MAX_SONARS];
+    int sonar_count;
+    Motor motors[MAX_MOTORS];
+    int motor_count;
+    int has_tone;
+    int has_profiler;
+    int has_binary_log;
+    int has_print_tenths;
     int used_pins[20];
     int pin_count;
+    char output_pins[PIN_STATE_COUNT];  // pinMode(pin, OUTPUT) already in setup
+    char runtime_pins[PIN_STATE_COUNT]; // Driven by a library or the generated runtime
+    char servo_pins[PIN_STATE_COUNT];   // Passed to myServo.attach
+    PinLevels pins;                     // What the code emitted so far leaves on each pin
+    LogMessage log_messages[LOG_MAX_MESSAGES];  // Compile-time string table for --binary-log
+    int log_message_count;
+    int log_table_full;
+    int too_long;           // A section ran out of room; reported as an error
 } ArduinoGen;
 
 // Error handling
-void add_error(Lexer* lexer, const char* message) {
+void add_error_at(Lexer* lexer, int line, int column, const char* message) {
     if (lexer->error_count < 20) {
-        snprintf(lexer->errors[lexer->error_count], 512, 
-                "Line %d, Col %d: %s", lexer->line, lexer->column, message);
+        snprintf(lexer->errors[lexer->error_count], sizeof(lexer->errors[0]),
+                "Line %d, Col %d: %s", line, column, message);
         lexer->error_count++;
     }
 }
 
+void sync_position(Lexer* lexer);
+
+void add_error(Lexer* lexer, const char* message) {
+    sync_position(lexer);
+    add_error_at(lexer, lexer->line, lexer->column, message);
+}
+
 // Initialize lexer
 Lexer* create_lexer(char* input) {
     Lexer* lexer = malloc(sizeof(Lexer));
@@ -103,28 +226,149 @@ Lexer* create_lexer(char* input) {
     lexer->length = strlen(input);
     lexer->line = 1;
     lexer->column = 1;
+    lexer->line_start = 0;
+    lexer->synced_pos = 0;
     lexer->error_count = 0;
     return lexer;
 }
 
+// ============================================================================
+// SCANNING PRIMITIVES
+// The lexer spends its time skipping blanks and comments and walking over
+// strings and names. These helpers look at 16 bytes per step with SSE2 and
+// fall back to a byte loop for the tail and on other targets. Line and
+// column are not tracked per character; sync_position() counts newlines
+// between token starts instead.
+// ============================================================================
+
+#ifdef __SSE2__
+int scan_simd = 1;      // Cleared by --bench-lexer to time the scalar path
+#else
+int scan_simd = 0;
+#endif
+
+static inline int is_blank(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline int is_word(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// First position at or after pos that is not a blank
+int scan_past_blanks(const char* input, int pos, int length) {
+#ifdef __SSE2__
+    if (scan_simd && pos < length && is_blank(input[pos])) {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i four = _mm_set1_epi8(4);
+        while (pos + 16 <= length) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(input + pos));
+            __m128i control = _mm_sub_epi8(chunk, tab);     // \t..\r become 0..4
+            __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                         _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+            int mask = ~_mm_movemask_epi8(blank) & 0xFFFF;
+            if (mask) return pos + __builtin_ctz(mask);
+            pos += 16;
+        }
+    }
+#endif
+    while (pos < length && is_blank(input[pos])) pos++;
+    return pos;
+}
+
+// Position of the next target byte at or after pos, or length
+int scan_to_byte(const char* input, int pos, int length, char target) {
+#ifdef __SSE2__
+    if (scan_simd) {
+        const __m128i wanted = _mm_set1_epi8(target);
+        while (pos + 16 <= length) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(input + pos));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));
+            if (mask) return pos + __builtin_ctz(mask);
+            pos += 16;
+        }
+    }
+#endif
+    while (pos < length && input[pos] != target) pos++;
+    return pos;
+}
+
+// First position at or after pos that is not a letter, digit or '_'
+int scan_past_word(const char* input, int pos, int length) {
+#ifdef __SSE2__
+    if (scan_simd) {
+        const __m128i case_bit = _mm_set1_epi8(0x20);
+        const __m128i before_a = _mm_set1_epi8('a' - 1), after_z = _mm_set1_epi8('z' + 1);
+        const __m128i before_0 = _mm_set1_epi8('0' - 1), after_9 = _mm_set1_epi8('9' + 1);
+        const __m128i underscore = _mm_set1_epi8('_');
+        while (pos + 16 <= length) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(input + pos));
+            __m128i lower = _mm_or_si128(chunk, case_bit);
+            __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, before_a), _mm_cmpgt_epi8(after_z, lower));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, before_0), _mm_cmpgt_epi8(after_9, chunk));
+            __m128i word = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(chunk, underscore));
+            int mask = ~_mm_movemask_epi8(word) & 0xFFFF;
+            if (mask) return pos + __builtin_ctz(mask);
+            pos += 16;
+        }
+    }
+#endif
+    while (pos < length && is_word(input[pos])) pos++;
+    return pos;
+}
+
+// Count newlines in [from, to); *last gets the offset of the final one
+int count_newlines(const char* input, int from, int to, int* last) {
+    int count = 0;
+#ifdef __SSE2__
+    if (scan_simd) {
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (from + 16 <= to) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(input + from));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+            if (mask) {
+                count += __builtin_popcount(mask);
+                *last = from + 31 - __builtin_clz(mask);
+            }
+            from += 16;
+        }
+    }
+#endif
+    for (; from < to; from++) {
+        if (input[from] == '\n') {
+            count++;
+            *last = from;
+        }
+    }
+    return count;
+}
+
+// Bring line/column up to date with pos (which may also have moved back)
+void sync_position(Lexer* lexer) {
+    int last = -1;
+    
+    if (lexer->pos >= lexer->synced_pos) {
+        lexer->line += count_newlines(lexer->input, lexer->synced_pos, lexer->pos, &last);
+        if (last >= 0) lexer->line_start = last + 1;
+    } else if (lexer->pos < lexer->line_start) {
+        lexer->line -= count_newlines(lexer->input, lexer->pos, lexer->synced_pos, &last);
+        lexer->line_start = lexer->pos;
+        while (lexer->line_start > 0 && lexer->input[lexer->line_start - 1] != '\n') {
+            lexer->line_start--;
+        }
+    }
+    lexer->synced_pos = lexer->pos;
+    lexer->column = lexer->pos - lexer->line_start + 1;
+}
+
 // Skip whitespace and comments
 void skip_whitespace_and_comments(Lexer* lexer) {
     while (lexer->pos < lexer->length) {
-        char current = lexer->input[lexer->pos];
+        lexer->pos = scan_past_blanks(lexer->input, lexer->pos, lexer->length);
         
-        if (isspace(current)) {
-            if (current == '\n') {
-                lexer->line++;
-                lexer->column = 1;
-            } else {
-                lexer->column++;
-            }
-            lexer->pos++;
-        }
-        else if (current == '/' && lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '/') {
-            while (lexer->pos < lexer->length && lexer->input[lexer->pos] != '\n') {
-                lexer->pos++;
-            }
+        if (lexer->pos + 1 < lexer->length && lexer->input[lexer->pos] == '/' && lexer->input[lexer->pos + 1] == '/') {
+            lexer->pos = scan_to_byte(lexer->input, lexer->pos, lexer->length, '\n');
         }
         else {
             break;
@@ -161,6 +405,7 @@ TokenType get_keyword_type(const char* word) {
         {"play_melody", TOKEN_PLAY_MELODY}, {"melody", TOKEN_PLAY_MELODY},
         
         // Motor Commands
+        {"motor", TOKEN_MOTOR},
         {"motor_forward", TOKEN_MOTOR_FORWARD}, {"forward", TOKEN_MOTOR_FORWARD},
         {"motor_backward", TOKEN_MOTOR_BACKWARD}, {"backward", TOKEN_MOTOR_BACKWARD},
         {"motor_stop", TOKEN_MOTOR_STOP}, {"stop", TOKEN_MOTOR_STOP},
@@ -176,6 +421,7 @@ TokenType get_keyword_type(const char* word) {
         {"if", TOKEN_IF}, {"when", TOKEN_IF},
         {"while", TOKEN_WHILE},
         {"forever", TOKEN_FOREVER}, {"always", TOKEN_FOREVER},
+        {"define", TOKEN_DEFINE}, {"do", TOKEN_DO},
         
         // Values
         {"high", TOKEN_HIGH}, {"low", TOKEN_LOW},
@@ -188,17 +434,25 @@ TokenType get_keyword_type(const char* word) {
     };
     
     for (int i = 0; keywords[i].word != NULL; i++) {
-        if (strcmp(word, keywords[i].word) == 0) {
+        if (keywords[i].word[0] == word[0] && strcmp(word, keywords[i].word) == 0) {
             return keywords[i].type;
         }
     }
     return TOKEN_PIN; // Default to pin reference
 }
 
+// Token text longer than Token.value is truncated
+static inline int token_length(int len) {
+    return len < (int)sizeof(((Token*)0)->value) - 1 ? len : (int)sizeof(((Token*)0)->value) - 1;
+}
+
 // Enhanced tokenizer
 Token get_next_token(Lexer* lexer) {
     Token token;
-    memset(&token, 0, sizeof(Token));
+    token.value[0] = '\0';     // Clearing all of value costs more than scanning most tokens
+    token.number = 0;
+    token.line = 0;
+    token.column = 0;
     
     skip_whitespace_and_comments(lexer);
     
@@ -208,6 +462,7 @@ Token get_next_token(Lexer* lexer) {
     }
     
     char current = lexer->input[lexer->pos];
+    sync_position(lexer);
     token.line = lexer->line;
     token.column = lexer->column;
     
@@ -216,10 +471,9 @@ Token get_next_token(Lexer* lexer) {
         int start = lexer->pos;
         while (lexer->pos < lexer->length && isdigit(lexer->input[lexer->pos])) {
             lexer->pos++;
-            lexer->column++;
         }
         
-        int len = lexer->pos - start;
+        int len = token_length(lexer->pos - start);
         strncpy(token.value, lexer->input + start, len);
         token.value[len] = '\0';
         token.number = atoi(token.value);
@@ -230,13 +484,9 @@ Token get_next_token(Lexer* lexer) {
     // Strings
     if (current == '"') {
         lexer->pos++; // skip opening quote
-        lexer->column++;
         int start = lexer->pos;
         
-        while (lexer->pos < lexer->length && lexer->input[lexer->pos] != '"') {
-            lexer->pos++;
-            lexer->column++;
-        }
+        lexer->pos = scan_to_byte(lexer->input, lexer->pos, lexer->length, '"');
         
         if (lexer->pos >= lexer->length) {
             add_error(lexer, "Unterminated string");
@@ -244,13 +494,12 @@ Token get_next_token(Lexer* lexer) {
             return token;
         }
         
-        int len = lexer->pos - start;
+        int len = token_length(lexer->pos - start);
         strncpy(token.value, lexer->input + start, len);
         token.value[len] = '\0';
         token.type = TOKEN_STRING;
         
         lexer->pos++; // skip closing quote
-        lexer->column++;
         return token;
     }
     
@@ -261,14 +510,12 @@ Token get_next_token(Lexer* lexer) {
             token.type = TOKEN_EQUALS;
             strcpy(token.value, "==");
             lexer->pos += 2;
-            lexer->column += 2;
             return token;
         }
         if (current == '!' && next == '=') {
             token.type = TOKEN_NOT_EQUALS;
             strcpy(token.value, "!=");
             lexer->pos += 2;
-            lexer->column += 2;
             return token;
         }
     }
@@ -288,13 +535,9 @@ Token get_next_token(Lexer* lexer) {
             if (isalpha(current) || current == '_') {
                 // Parse identifier/keyword
                 int start = lexer->pos;
-                while (lexer->pos < lexer->length && 
-                       (isalnum(lexer->input[lexer->pos]) || lexer->input[lexer->pos] == '_')) {
-                    lexer->pos++;
-                    lexer->column++;
-                }
+                lexer->pos = scan_past_word(lexer->input, lexer->pos, lexer->length);
                 
-                int len = lexer->pos - start;
+                int len = token_length(lexer->pos - start);
                 strncpy(token.value, lexer->input + start, len);
                 token.value[len] = '\0';
                 
@@ -321,7 +564,6 @@ Token get_next_token(Lexer* lexer) {
     token.value[0] = current;
     token.value[1] = '\0';
     lexer->pos++;
-    lexer->column++;
     
     return token;
 }
@@ -331,24 +573,54 @@ ArduinoGen* create_arduino_gen() {
     ArduinoGen* gen = malloc(sizeof(ArduinoGen));
     memset(gen, 0, sizeof(ArduinoGen));
     
+    gen->options = compile_options;
+    
     strcpy(gen->includes, "// Generated by Arduino Kids Programming Language\n");
-    strcpy(gen->setup_code, "void setup() {\n  Serial.begin(9600);\n");
+    // Binary streams must not stall the statements they report on
+    int baud_rate = gen->options.baud_rate;
+    if (baud_rate == 0) {
+        baud_rate = (gen->options.profile || gen->options.binary_log) ? 115200 : 9600;
+    }
+    snprintf(gen->setup_code, sizeof(gen->setup_code), "void setup() {\n  Serial.begin(%d);\n", baud_rate);
     strcpy(gen->loop_code, "\nvoid loop() {\n");
+    gen->code = gen->loop_code;
     gen->indent_level = 1;
     
     return gen;
 }
 
+// Capacity of the section target points into
+size_t section_size(ArduinoGen* gen, const char* target) {
+    if (target == gen->setup_code) return sizeof(gen->setup_code);
+    if (target == gen->loop_code) return sizeof(gen->loop_code);
+    if (target == gen->includes) return sizeof(gen->includes);
+    if (target == gen->globals) return sizeof(gen->globals);
+    return sizeof(gen->functions);
+}
+
+// Append to a section; text that doesn't fit is dropped and flagged instead
+// of running into the next buffer
+void append_code(ArduinoGen* gen, char* target, const char* text) {
+    size_t used = strlen(target);
+    size_t length = strlen(text);
+    
+    if (used + length >= section_size(gen, target)) {
+        gen->too_long = 1;
+        return;
+    }
+    memcpy(target + used, text, length + 1);
+}
+
 void add_indent_arduino(ArduinoGen* gen, char* target) {
     for (int i = 0; i < gen->indent_level; i++) {
-        strcat(target, "  ");
+        append_code(gen, target, "  ");
     }
 }
 
 void add_line_arduino(ArduinoGen* gen, char* target, const char* line) {
     add_indent_arduino(gen, target);
-    strcat(target, line);
-    strcat(target, "\n");
+    append_code(gen, target, line);
+    append_code(gen, target, "\n");
 }
 
 void add_pin_usage(ArduinoGen* gen, int pin) {
@@ -360,9 +632,760 @@ void add_pin_usage(ArduinoGen* gen, int pin) {
     }
 }
 
+// ============================================================================
+// SERIAL MESSAGES (--binary-log)
+// Every message the sketch prints goes through these helpers. In binary mode
+// each distinct message becomes an ID in a compile-time string table and is
+// sent as an 8-byte record instead of ~30 bytes of text:
+//   0xC3 <id:u8> <value:i16 LE> <millis:u32 LE>
+// The host rebuilds the same table from the program with --log-decode.
+// ============================================================================
+
+#define LOG_SYNC 0xC3
+#define LOG_RECORD_BYTES 8
+
+static const char* binary_log_runtime =
+    "// Binary log records, decode on the host with: inter --log-decode <program>\n"
+    "void log_event(uint8_t id, int16_t value) {\n"
+    "  uint32_t now = millis();\n"
+    "  uint8_t record[8] = {\n"
+    "    0xC3, id, (uint8_t)value, (uint8_t)(value >> 8),\n"
+    "    (uint8_t)now, (uint8_t)(now >> 8), (uint8_t)(now >> 16), (uint8_t)(now >> 24)\n"
+    "  };\n"
+    "  Serial.write(record, 8);\n"
+    "}\n\n";
+
+// Find or add a string table entry; -1 (and gen->log_table_full) when the
+// table is full, since falling back to text would corrupt the binary stream
+int log_message_id(ArduinoGen* gen, const char* prefix, const char* suffix, int has_value, int scale) {
+    for (int i = 0; i < gen->log_message_count; i++) {
+        LogMessage* message = &gen->log_messages[i];
+        if (message->has_value == has_value && message->scale == scale &&
+            strcmp(message->prefix, prefix) == 0 && strcmp(message->suffix, suffix) == 0) {
+            return i;
+        }
+    }
+    if (gen->log_message_count >= LOG_MAX_MESSAGES) {
+        gen->log_table_full = 1;
+        return -1;
+    }
+    
+    LogMessage* message = &gen->log_messages[gen->log_message_count];
+    snprintf(message->prefix, sizeof(message->prefix), "%s", prefix);
+    snprintf(message->suffix, sizeof(message->suffix), "%s", suffix);
+    message->has_value = has_value;
+    message->scale = scale;
+    
+    if (!gen->has_binary_log) {
+        append_code(gen, gen->globals, binary_log_runtime);
+        gen->has_binary_log = 1;
+    }
+    return gen->log_message_count++;
+}
+
+void emit_serial_message(ArduinoGen* gen, char* target, const char* text) {
+    char code[544];     // text is at most 511 bytes
+    
+    if (gen->options.binary_log) {
+        int id = log_message_id(gen, text, "", 0, 1);
+        if (id < 0) return;
+        snprintf(code, sizeof(code), "log_event(%d, 0);  // %s", id, text);
+    } else {
+        snprintf(code, sizeof(code), "Serial.println(\"%s\");", text);
+    }
+    add_line_arduino(gen, target, code);
+}
+
+// expr is sent as value * scale so one decimal place survives the int16 record
+void emit_serial_value(ArduinoGen* gen, char* target, const char* prefix,
+                       const char* expr, const char* suffix, int scale) {
+    char code[512];
+    
+    if (gen->options.binary_log) {
+        int id = log_message_id(gen, prefix, suffix, 1, scale);
+        if (id < 0) return;
+        if (scale == 1) {
+            snprintf(code, sizeof(code), "log_event(%d, (int16_t)(%s));  // %s", id, expr, prefix);
+        } else {
+            snprintf(code, sizeof(code), "log_event(%d, (int16_t)(%s * %d));  // %s", id, expr, scale, prefix);
+        }
+        add_line_arduino(gen, target, code);
+        return;
+    }
+    
+    snprintf(code, sizeof(code), "Serial.print(\"%s\");", prefix);
+    add_line_arduino(gen, target, code);
+    snprintf(code, sizeof(code), "Serial.print(%s);", expr);
+    add_line_arduino(gen, target, code);
+    snprintf(code, sizeof(code), "Serial.println(\"%s\");", suffix);
+    add_line_arduino(gen, target, code);
+}
+
+// A message with one numeric argument. Text output prints a constant as part
+// of the message; the binary log always sends it in the record's value, so
+// every use of a command shares one string table entry
+void emit_serial_argument(ArduinoGen* gen, char* target, const char* prefix,
+                          const char* value, const char* suffix, int constant) {
+    char text[512];
+    
+    if (constant && !gen->options.binary_log) {
+        snprintf(text, sizeof(text), "%.160s%.80s%.32s", prefix, value, suffix);
+        emit_serial_message(gen, target, text);
+    } else {
+        emit_serial_value(gen, target, prefix, value, suffix, 1);
+    }
+}
+
+static const char* print_tenths_runtime =
+    "// Print an integer number of tenths as a decimal\n"
+    "void print_tenths(int16_t tenths) {\n"
+    "  if (tenths < 0) {\n"
+    "    Serial.print('-');\n"
+    "    tenths = -tenths;\n"
+    "  }\n"
+    "  Serial.print(tenths / 10);\n"
+    "  Serial.print('.');\n"
+    "  Serial.print(tenths % 10);\n"
+    "}\n\n";
+
+// Like emit_serial_value, but expr is already an integer count of tenths
+// (--fixed-point); it goes into the binary log as-is with scale 10
+void emit_serial_tenths(ArduinoGen* gen, char* target, const char* prefix,
+                        const char* expr, const char* suffix) {
+    char code[512];
+    
+    if (gen->options.binary_log) {
+        int id = log_message_id(gen, prefix, suffix, 1, 10);
+        if (id < 0) return;
+        snprintf(code, sizeof(code), "log_event(%d, (int16_t)(%s));  // %s", id, expr, prefix);
+        add_line_arduino(gen, target, code);
+        return;
+    }
+    
+    if (!gen->has_print_tenths) {
+        append_code(gen, gen->globals, print_tenths_runtime);
+        gen->has_print_tenths = 1;
+    }
+    snprintf(code, sizeof(code), "Serial.print(\"%s\");", prefix);
+    add_line_arduino(gen, target, code);
+    snprintf(code, sizeof(code), "print_tenths(%s);", expr);
+    add_line_arduino(gen, target, code);
+    snprintf(code, sizeof(code), "Serial.println(\"%s\");", suffix);
+    add_line_arduino(gen, target, code);
+}
+
+// ============================================================================
+// PROFILER INSTRUMENTATION (--profile)
+// Each simple statement is timed with micros() and tagged with its source
+// line. Samples collect in a fixed-size buffer that is sent as a binary frame
+// when full or once per PROFILE_FLUSH_MS:
+//   0xA5 0x5A <count> count * (<line:u16 LE> <micros:u32 LE>) <sum of payload bytes:u8>
+// ============================================================================
+
+#define PROFILE_SYNC_0 0xA5
+#define PROFILE_SYNC_1 0x5A
+#define PROFILE_RING_SIZE 32
+#define PROFILE_RECORD_BYTES 6
+#define PROFILE_FLUSH_MS 1000
+
+static const char* profiler_runtime =
+    "// Profiler: per-statement timings, sent over Serial as binary frames\n"
+    "#define PROF_RING_SIZE 32\n"
+    "#define PROF_FLUSH_MS 1000\n"
+    "uint16_t prof_lines[PROF_RING_SIZE];\n"
+    "uint32_t prof_micros[PROF_RING_SIZE];\n"
+    "uint8_t prof_count = 0;\n"
+    "unsigned long prof_last_flush = 0;\n"
+    "\n"
+    "void prof_flush() {\n"
+    "  uint8_t checksum = 0;\n"
+    "  Serial.write(0xA5);\n"
+    "  Serial.write(0x5A);\n"
+    "  Serial.write(prof_count);\n"
+    "  for (uint8_t i = 0; i < prof_count; i++) {\n"
+    "    uint8_t record[6] = {\n"
+    "      (uint8_t)prof_lines[i], (uint8_t)(prof_lines[i] >> 8),\n"
+    "      (uint8_t)prof_micros[i], (uint8_t)(prof_micros[i] >> 8),\n"
+    "      (uint8_t)(prof_micros[i] >> 16), (uint8_t)(prof_micros[i] >> 24)\n"
+    "    };\n"
+    "    for (uint8_t j = 0; j < 6; j++) checksum += record[j];\n"
+    "    Serial.write(record, 6);\n"
+    "  }\n"
+    "  Serial.write(checksum);\n"
+    "  prof_count = 0;\n"
+    "  prof_last_flush = millis();\n"
+    "}\n"
+    "\n"
+    "void prof_record(uint16_t line, uint32_t elapsed) {\n"
+    "  prof_lines[prof_count] = line;\n"
+    "  prof_micros[prof_count] = elapsed;\n"
+    "  prof_count++;\n"
+    "  if (prof_count == PROF_RING_SIZE || millis() - prof_last_flush >= PROF_FLUSH_MS) {\n"
+    "    prof_flush();\n"
+    "  }\n"
+    "}\n\n";
+
+// Only leaf commands are timed so nested repeat bodies are never counted twice
+int is_profiled_statement(TokenType type) {
+    switch (type) {
+        case TOKEN_TURN_ON: case TOKEN_TURN_OFF: case TOKEN_BLINK: case TOKEN_BEEP:
+        case TOKEN_READ_TEMP: case TOKEN_READ_DISTANCE: case TOKEN_MOVE_SERVO:
+        case TOKEN_PRINT_LCD: case TOKEN_PRINT_SERIAL: case TOKEN_WAIT:
+        case TOKEN_MOTOR_FORWARD: case TOKEN_MOTOR_BACKWARD: case TOKEN_MOTOR_STOP:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void begin_profiled_statement(ArduinoGen* gen, int line) {
+    char code[64];
+    
+    if (!gen->has_profiler) {
+        append_code(gen, gen->globals, profiler_runtime);
+        gen->has_profiler = 1;
+    }
+    
+    snprintf(code, sizeof(code), "{  // line %d", line);
+    add_line_arduino(gen, gen->code, code);
+    gen->indent_level++;
+    add_line_arduino(gen, gen->code, "uint32_t prof_start = micros();");
+}
+
+void end_profiled_statement(ArduinoGen* gen, int line) {
+    char code[64];
+    
+    snprintf(code, sizeof(code), "prof_record(%d, micros() - prof_start);", line);
+    add_line_arduino(gen, gen->code, code);
+    gen->indent_level--;
+    add_line_arduino(gen, gen->code, "}");
+}
+
+// ============================================================================
+// ULTRASONIC SENSORS
+// pulseIn() stalls the sketch for the whole echo (up to a second with nothing
+// in range). Instead the echo pins raise pin-change interrupts that timestamp
+// both edges, and sonar_update() pings one sensor per SONAR_PING_MS slot so
+// their echoes never overlap. It runs from yield(), which delay() calls while
+// it waits, and from every read, so read_distance just returns the latest
+// finished measurement. --distance-interval stretches the slots so each
+// sensor is pinged no more often than requested.
+// ============================================================================
+
+static const char* sonar_runtime =
+    "#define SONAR_MAX_ECHO_US 25000\n"
+    "volatile uint32_t sonar_echo_us[SONAR_COUNT];   // 0 = nothing in range\n"
+    "volatile uint32_t sonar_rise_us;\n"
+    "volatile uint8_t sonar_active = 0;\n"
+    "volatile uint8_t sonar_state = 0;                // 0 idle, 1 pinged, 2 echo high\n"
+    "unsigned long sonar_last_ping = 0;\n"
+    "\n"
+    "void sonar_echo_change() {\n"
+    "  uint8_t level = digitalRead(sonar_echo[sonar_active]);\n"
+    "  if (level == HIGH && sonar_state == 1) {\n"
+    "    sonar_rise_us = micros();\n"
+    "    sonar_state = 2;\n"
+    "  } else if (level == LOW && sonar_state == 2) {\n"
+    "    uint32_t width = micros() - sonar_rise_us;\n"
+    "    sonar_echo_us[sonar_active] = width < SONAR_MAX_ECHO_US ? width : 0;\n"
+    "    sonar_state = 0;\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "#ifdef PCINT0_vect\n"
+    "ISR(PCINT0_vect) { sonar_echo_change(); }\n"
+    "#endif\n"
+    "#ifdef PCINT1_vect\n"
+    "ISR(PCINT1_vect) { sonar_echo_change(); }\n"
+    "#endif\n"
+    "#ifdef PCINT2_vect\n"
+    "ISR(PCINT2_vect) { sonar_echo_change(); }\n"
+    "#endif\n"
+    "\n"
+    "void sonar_begin() {\n"
+    "  for (uint8_t i = 0; i < SONAR_COUNT; i++) {\n"
+    "    pinMode(sonar_trig[i], OUTPUT);\n"
+    "    pinMode(sonar_echo[i], INPUT);\n"
+    "    volatile uint8_t* mask = digitalPinToPCMSK(sonar_echo[i]);\n"
+    "    if (!mask) continue;           // No pin-change interrupt on this pin (e.g. on a Mega)\n"
+    "    *mask |= bit(digitalPinToPCMSKbit(sonar_echo[i]));\n"
+    "    PCIFR |= bit(digitalPinToPCICRbit(sonar_echo[i]));\n"
+    "    PCICR |= bit(digitalPinToPCICRbit(sonar_echo[i]));\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "// Ping the next sensor once its slot comes up; never waits for an echo\n"
+    "void sonar_update() {\n"
+    "  unsigned long now = millis();\n"
+    "  if (now - sonar_last_ping < SONAR_PING_MS) return;\n"
+    "  noInterrupts();\n"
+    "  if (sonar_state != 0) sonar_echo_us[sonar_active] = 0;   // Echo never finished\n"
+    "  sonar_active = (sonar_active + 1) % SONAR_COUNT;\n"
+    "  sonar_state = 1;\n"
+    "  interrupts();\n"
+    "  sonar_last_ping = now;\n"
+    "  digitalWrite(sonar_trig[sonar_active], LOW);\n"
+    "  delayMicroseconds(2);\n"
+    "  digitalWrite(sonar_trig[sonar_active], HIGH);\n"
+    "  delayMicroseconds(10);\n"
+    "  digitalWrite(sonar_trig[sonar_active], LOW);\n"
+    "}\n\n";
+
+static const char* sonar_distance_float =
+    "float sonar_distance(uint8_t i) {\n"
+    "  sonar_update();\n"
+    "  noInterrupts();\n"
+    "  uint32_t echo_us = sonar_echo_us[i];\n"
+    "  interrupts();\n"
+    "  return echo_us * 0.034 / 2;\n"
+    "}\n\n";
+
+// Sound covers 0.34 mm/us, there and back
+static const char* sonar_distance_fixed =
+    "uint16_t sonar_distance(uint8_t i) {   // Millimetres\n"
+    "  sonar_update();\n"
+    "  noInterrupts();\n"
+    "  uint32_t echo_us = sonar_echo_us[i];\n"
+    "  interrupts();\n"
+    "  return echo_us * 17 / 100;\n"
+    "}\n\n";
+
+// Sensor number for a trig/echo pair, adding it on first use
+int sonar_index(Lexer* lexer, ArduinoGen* gen, Token trig_pin, Token echo_pin) {
+    char message[128];
+    
+    // Every Uno pin has a pin-change interrupt, but 0 and 1 carry Serial
+    if (echo_pin.number < 2 || echo_pin.number > 19) {
+        snprintf(message, sizeof(message), "Pin %d can't time an echo; use pins 2-13 or A0-A5 (14-19)",
+                 echo_pin.number);
+        add_error_at(lexer, echo_pin.line, echo_pin.column, message);
+        return -1;
+    }
+    for (int i = 0; i < gen->sonar_count; i++) {
+        if (gen->sonar_trig[i] == trig_pin.number && gen->sonar_echo[i] == echo_pin.number) return i;
+        if (gen->sonar_echo[i] == echo_pin.number || gen->sonar_trig[i] == trig_pin.number) {
+            snprintf(message, sizeof(message), "Pins %d and %d are already used by distance sensor %d",
+                     trig_pin.number, echo_pin.number, i);
+            add_error_at(lexer, trig_pin.line, trig_pin.column, message);
+            return -1;
+        }
+    }
+    if (gen->sonar_count == MAX_SONARS) {
+        add_error_at(lexer, trig_pin.line, trig_pin.column, "Too many distance sensors");
+        return -1;
+    }
+    
+    add_pin_usage(gen, trig_pin.number);
+    add_pin_usage(gen, echo_pin.number);
+    gen->sonar_trig[gen->sonar_count] = trig_pin.number;
+    gen->sonar_echo[gen->sonar_count] = echo_pin.number;
+    gen->sonar_line[gen->sonar_count] = trig_pin.line;
+    gen->sonar_column[gen->sonar_count] = trig_pin.column;
+    return gen->sonar_count++;
+}
+
+// One sensor is pinged per slot, so each one is sampled every slot * count ms
+int sonar_slot_ms(ArduinoGen* gen) {
+    int slot = (gen->options.distance_interval_ms + gen->sonar_count - 1) / gen->sonar_count;
+    return slot > SONAR_SLOT_MS ? slot : SONAR_SLOT_MS;
+}
+
+// The pin tables need every sensor, so the runtime is written once parsing is done
+void emit_sonar_runtime(ArduinoGen* gen) {
+    char code[256];
+    int len;
+    
+    if (gen->sonar_count == 0) return;
+    
+    append_code(gen, gen->globals, "// Ultrasonic sensors: echoes are timed by pin-change interrupts\n");
+    snprintf(code, sizeof(code), "#define SONAR_COUNT %d\n", gen->sonar_count);
+    append_code(gen, gen->globals, code);
+    snprintf(code, sizeof(code), "#define SONAR_PING_MS %d\n", sonar_slot_ms(gen));
+    append_code(gen, gen->globals, code);
+    for (int table = 0; table < 2; table++) {
+        int* pins = table == 0 ? gen->sonar_trig : gen->sonar_echo;
+        len = snprintf(code, sizeof(code), "const uint8_t sonar_%s[SONAR_COUNT] = {",
+                       table == 0 ? "trig" : "echo");
+        for (int i = 0; i < gen->sonar_count; i++) {
+            len += snprintf(code + len, sizeof(code) - len, "%s%d", i ? ", " : "", pins[i]);
+        }
+        snprintf(code + len, sizeof(code) - len, "};\n");
+        append_code(gen, gen->globals, code);
+    }
+    append_code(gen, gen->globals, sonar_runtime);
+    append_code(gen, gen->globals, gen->options.fixed_point ? sonar_distance_fixed : sonar_distance_float);
+    add_line_arduino(gen, gen->setup_code, "sonar_begin();");
+}
+
+// ============================================================================
+// TEMPERATURE SENSORS
+// A DHT22 read holds the sketch for ~250 ms and the sensor only has a new
+// value every 2 s, so readings are cached per sensor. read_temperature
+// returns the cached value until it is TEMP_SAMPLE_MS old; refreshes happen
+// from yield() while delay() waits, one sensor at a time.
+// With --fixed-point the DHT library (which only returns float) is replaced
+// by a bit-banged DHT22 reader that returns int16_t tenths of a degree.
+// ============================================================================
+
+static const char* temp_sample_float =
+    "typedef float temp_t;\n"
+    "\n"
+    "temp_t temp_sample(uint8_t i) {\n"
+    "  return temp_sensors[i].readTemperature();\n"
+    "}\n\n";
+
+static const char* temp_sample_fixed =
+    "typedef int16_t temp_t;       // Tenths of a degree\n"
+    "#define TEMP_ERROR INT16_MIN\n"
+    "\n"
+    "// micros() can't be used with interrupts off (Timer0 overflows are lost\n"
+    "// after ~1 ms), so pulses are measured in loop passes, like Adafruit's DHT\n"
+    "#define TEMP_PULSE_LIMIT 4000   // Passes; far longer than the 80 us the sensor holds a level\n"
+    "\n"
+    "// Loop passes until pin leaves level, 0 on timeout\n"
+    "uint16_t temp_pulse(uint8_t pin, uint8_t level) {\n"
+    "  uint16_t count = 1;\n"
+    "  while (digitalRead(pin) == level) {\n"
+    "    if (++count >= TEMP_PULSE_LIMIT) return 0;\n"
+    "  }\n"
+    "  return count;\n"
+    "}\n"
+    "\n"
+    "// One DHT22 transaction: 40 bits, each a 50 us low then a high pulse that\n"
+    "// is a 1 when it lasts longer than the low one (70 us against 27 us)\n"
+    "temp_t temp_sample(uint8_t i) {\n"
+    "  uint8_t pin = temp_pins[i];\n"
+    "  uint8_t data[5] = {0, 0, 0, 0, 0};\n"
+    "  pinMode(pin, OUTPUT);\n"
+    "  digitalWrite(pin, LOW);\n"
+    "  delayMicroseconds(1100);     // Start signal\n"
+    "  pinMode(pin, INPUT_PULLUP);\n"
+    "  noInterrupts();\n"
+    "  uint8_t ok = temp_pulse(pin, HIGH) && temp_pulse(pin, LOW) && temp_pulse(pin, HIGH);\n"
+    "  for (uint8_t bit_index = 0; ok && bit_index < 40; bit_index++) {\n"
+    "    uint16_t low = temp_pulse(pin, LOW);\n"
+    "    uint16_t high = low ? temp_pulse(pin, HIGH) : 0;\n"
+    "    ok = high != 0;\n"
+    "    data[bit_index / 8] = (data[bit_index / 8] << 1) | (high > low);\n"
+    "  }\n"
+    "  interrupts();\n"
+    "  if (!ok || (uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4]) return TEMP_ERROR;\n"
+    "  int16_t tenths = ((data[2] & 0x7F) << 8) | data[3];\n"
+    "  return data[2] & 0x80 ? -tenths : tenths;\n"
+    "}\n\n";
+
+static const char* temp_runtime =
+    "temp_t temp_value[TEMP_COUNT];\n"
+    "unsigned long temp_read_at[TEMP_COUNT];\n"
+    "uint8_t temp_ready[TEMP_COUNT];\n"
+    "uint8_t temp_busy = 0;        // A read that calls delay() re-enters yield()\n"
+    "\n"
+    "uint8_t temp_stale(uint8_t i) {\n"
+    "  return !temp_ready[i] || millis() - temp_read_at[i] >= TEMP_SAMPLE_MS;\n"
+    "}\n"
+    "\n"
+    "void temp_refresh(uint8_t i) {\n"
+    "  temp_busy = 1;\n"
+    "  temp_value[i] = temp_sample(i);\n"
+    "  temp_read_at[i] = millis();\n"
+    "  temp_ready[i] = 1;\n"
+    "  temp_busy = 0;\n"
+    "}\n"
+    "\n"
+    "// Refresh at most one stale sensor per call\n"
+    "void temp_update() {\n"
+    "  if (temp_busy) return;\n"
+    "  for (uint8_t i = 0; i < TEMP_COUNT; i++) {\n"
+    "    if (temp_stale(i)) {\n"
+    "      temp_refresh(i);\n"
+    "      return;\n"
+    "    }\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "temp_t temp_read(uint8_t i) {\n"
+    "  if (!temp_busy && temp_stale(i)) temp_refresh(i);\n"
+    "  return temp_value[i];\n"
+    "}\n\n";
+
+int temp_interval_ms(ArduinoGen* gen) {
+    return gen->options.temp_interval_ms > 0 ? gen->options.temp_interval_ms : DEFAULT_TEMP_INTERVAL_MS;
+}
+
+// Sensor number for a DHT data pin, adding it on first use
+int temp_index(Lexer* lexer, ArduinoGen* gen, Token pin) {
+    for (int i = 0; i < gen->temp_count; i++) {
+        if (gen->temp_pins[i] == pin.number) return i;
+    }
+    if (gen->temp_count == MAX_TEMP_SENSORS) {
+        add_error_at(lexer, pin.line, pin.column, "Too many temperature sensors");
+        return -1;
+    }
+    
+    add_pin_usage(gen, pin.number);
+    gen->temp_pins[gen->temp_count] = pin.number;
+    return gen->temp_count++;
+}
+
+void emit_temp_runtime(ArduinoGen* gen) {
+    char code[256];
+    
+    if (gen->temp_count == 0) return;
+    
+    append_code(gen, gen->globals, "// Temperature sensors: readings are cached and refreshed in the background\n");
+    snprintf(code, sizeof(code), "#define TEMP_COUNT %d\n#define TEMP_SAMPLE_MS %d\n",
+             gen->temp_count, temp_interval_ms(gen));
+    append_code(gen, gen->globals, code);
+    
+    if (gen->options.fixed_point) {
+        append_code(gen, gen->globals, "const uint8_t temp_pins[TEMP_COUNT] = {");
+        for (int i = 0; i < gen->temp_count; i++) {
+            snprintf(code, sizeof(code), "%s%d", i ? ", " : "", gen->temp_pins[i]);
+            append_code(gen, gen->globals, code);
+        }
+        append_code(gen, gen->globals, "};\n");
+        append_code(gen, gen->globals, temp_sample_fixed);
+        append_code(gen, gen->globals, temp_runtime);
+        add_line_arduino(gen, gen->setup_code, "for (uint8_t i = 0; i < TEMP_COUNT; i++) pinMode(temp_pins[i], INPUT_PULLUP);");
+        return;
+    }
+    
+    append_code(gen, gen->includes, "#include <DHT.h>\n");
+    append_code(gen, gen->globals, "DHT temp_sensors[TEMP_COUNT] = {");
+    for (int i = 0; i < gen->temp_count; i++) {
+        snprintf(code, sizeof(code), "%s DHT(%d, DHT22)", i ? "," : "", gen->temp_pins[i]);
+        append_code(gen, gen->globals, code);
+    }
+    append_code(gen, gen->globals, " };\n");
+    append_code(gen, gen->globals, temp_sample_float);
+    append_code(gen, gen->globals, temp_runtime);
+    
+    add_line_arduino(gen, gen->setup_code, "for (uint8_t i = 0; i < TEMP_COUNT; i++) temp_sensors[i].begin();");
+}
+
+// delay() calls yield() while it waits; background sensor and motor work runs there
+void emit_background_tasks(ArduinoGen* gen) {
+    if (gen->sonar_count == 0 && gen->temp_count == 0 && gen->motor_count == 0) return;
+    
+    append_code(gen, gen->globals, "void yield() {\n");
+    if (gen->sonar_count > 0) append_code(gen, gen->globals, "  sonar_update();\n");
+    if (gen->temp_count > 0) append_code(gen, gen->globals, "  temp_update();\n");
+    if (gen->motor_count > 0) append_code(gen, gen->globals, "  motor_update();\n");
+    append_code(gen, gen->globals, "}\n\n");
+}
+
+void print_sampling_summary(ArduinoGen* gen) {
+    if (gen->sonar_count == 0 && gen->temp_count == 0) return;
+    
+    printf("Sensor Sampling:\n");
+    printf("-------------------\n");
+    for (int i = 0; i < gen->temp_count; i++) {
+        int interval = temp_interval_ms(gen);
+        printf("   Temperature sensor %d (pin %d): every %d ms (%.2f Hz), reads in between use the cached value\n",
+               i, gen->temp_pins[i], interval, 1000.0 / interval);
+    }
+    for (int i = 0; i < gen->sonar_count; i++) {
+        int interval = sonar_slot_ms(gen) * gen->sonar_count;
+        printf("   Distance sensor %d (pins %d/%d): every %d ms (%.1f Hz)\n",
+               i, gen->sonar_trig[i], gen->sonar_echo[i], interval, 1000.0 / interval);
+    }
+    printf("\n");
+}
+
+// ============================================================================
+// PIN-STATE DATAFLOW
+// Output pins start LOW after setup(). As statements are emitted, gen->pins
+// tracks the level each one is known to have, so a turn_on of a pin that is
+// already HIGH emits no digitalWrite. Before a loop body is emitted its tokens
+// are scanned once into a PinEffects summary; every pin's effect is "left
+// alone", "set to a level" or "maybe set to a level", so the loop's entry
+// state is simply join(before, body(before)). loop() is treated the same way.
+// Pins driven by a library or the generated runtime (LCD, motors, distance
+// and temperature sensors, servo) are never known.
+// ============================================================================
+
+#define EFFECT_NONE 0
+#define EFFECT_SET 1
+#define EFFECT_MAYBE 2      // Joined with the level the pin already had
+
+typedef struct {
+    signed char kind[PIN_STATE_COUNT];
+    signed char level[PIN_STATE_COUNT];
+} PinEffects;
+
+void pin_levels_reset(PinLevels* pins, int level) {
+    memset(pins->level, level, sizeof(pins->level));
+}
+
+void pin_levels_join(PinLevels* into, const PinLevels* other) {
+    for (int i = 0; i < PIN_STATE_COUNT; i++) {
+        if (into->level[i] != other->level[i]) into->level[i] = PIN_UNKNOWN;
+    }
+}
+
+int pin_level(ArduinoGen* gen, int pin) {
+    if (pin < 0 || pin >= PIN_STATE_COUNT || gen->runtime_pins[pin]) return PIN_UNKNOWN;
+    return gen->pins.level[pin];
+}
+
+void set_pin_level(ArduinoGen* gen, int pin, int level) {
+    if (pin >= 0 && pin < PIN_STATE_COUNT) gen->pins.level[pin] = level;
+}
+
+void set_runtime_pin(ArduinoGen* gen, int pin) {
+    if (pin >= 0 && pin < PIN_STATE_COUNT) gen->runtime_pins[pin] = 1;
+}
+
+// Emits pinMode(pin, OUTPUT) into setup the first time a pin is used as an output
+void use_output_pin(ArduinoGen* gen, int pin) {
+    char code[64];
+    
+    add_pin_usage(gen, pin);
+    if (pin >= 0 && pin < PIN_STATE_COUNT) {
+        if (gen->output_pins[pin]) return;
+        gen->output_pins[pin] = 1;
+    }
+    snprintf(code, sizeof(code), "  pinMode(%d, OUTPUT);\n", pin);
+    append_code(gen, gen->setup_code, code);
+}
+
+// Adds one more effect on a pin after the ones already in effects
+void pin_effect(PinEffects* effects, int pin, int kind, int level) {
+    if (pin < 0 || pin >= PIN_STATE_COUNT || kind == EFFECT_NONE) return;
+    if (kind == EFFECT_MAYBE && effects->kind[pin] != EFFECT_NONE) {
+        if (effects->level[pin] != level) effects->level[pin] = PIN_UNKNOWN;
+        return;     // Set-then-maybe stays a set, maybe-then-maybe a maybe
+    }
+    effects->kind[pin] = kind;
+    effects->level[pin] = level;
+}
+
+void pin_effects_then(PinEffects* into, const PinEffects* next) {
+    for (int i = 0; i < PIN_STATE_COUNT; i++) pin_effect(into, i, next->kind[i], next->level[i]);
+}
+
+void pin_effects_apply(const PinEffects* effects, PinLevels* pins) {
+    for (int i = 0; i < PIN_STATE_COUNT; i++) {
+        if (effects->kind[i] == EFFECT_SET) {
+            pins->level[i] = effects->level[i];
+        } else if (effects->kind[i] == EFFECT_MAYBE && pins->level[i] != effects->level[i]) {
+            pins->level[i] = PIN_UNKNOWN;
+        }
+    }
+}
+
+// Summarizes the statements up to the closing '}' (or the end of the program
+// when nested is 0) the way parse_statement will emit them. Pins claimed by
+// a subsystem are marked in gen->runtime_pins. The lexer is left where it was.
+void scan_pin_effects(Lexer* lexer, ArduinoGen* gen, PinEffects* effects, int nested) {
+    Token token;
+    
+    memset(effects, 0, sizeof(PinEffects));
+    while ((token = get_next_token(lexer)).type != TOKEN_EOF) {
+        if (token.type == TOKEN_RBRACE && nested) break;
+        
+        switch (token.type) {
+            case TOKEN_TURN_ON:
+            case TOKEN_TURN_OFF: {
+                Token pin = get_next_token(lexer);
+                if (pin.type == TOKEN_NUMBER) {
+                    pin_effect(effects, pin.number, EFFECT_SET, token.type == TOKEN_TURN_ON ? PIN_HIGH : PIN_LOW);
+                }
+                break;
+            }
+            
+            case TOKEN_BLINK: {
+                Token pin = get_next_token(lexer);
+                Token times = get_next_token(lexer);
+                if (pin.type != TOKEN_NUMBER) break;
+                int always = times.type == TOKEN_NUMBER && times.number > 0;   // Else maybe zero blinks
+                pin_effect(effects, pin.number, always ? EFFECT_SET : EFFECT_MAYBE, PIN_LOW);
+                break;
+            }
+            
+            case TOKEN_BEEP:
+            case TOKEN_MOVE_SERVO: {
+                Token pin = get_next_token(lexer);
+                if (pin.type != TOKEN_NUMBER) break;
+                pin_effect(effects, pin.number, EFFECT_SET, PIN_UNKNOWN);
+                if (token.type == TOKEN_MOVE_SERVO) set_runtime_pin(gen, pin.number);
+                break;
+            }
+            
+            case TOKEN_READ_TEMP:
+            case TOKEN_READ_DISTANCE:
+            case TOKEN_MOTOR: {
+                int pins = token.type == TOKEN_READ_TEMP ? 1 : token.type == TOKEN_READ_DISTANCE ? 2 : 3;
+                if (token.type == TOKEN_MOTOR) get_next_token(lexer);   // Motor name
+                for (int i = 0; i < pins; i++) {
+                    Token pin = get_next_token(lexer);
+                    if (pin.type == TOKEN_NUMBER) set_runtime_pin(gen, pin.number);
+                }
+                break;
+            }
+            
+            case TOKEN_PRINT_LCD: {
+                static const int lcd_pins[] = { 12, 11, 5, 4, 3, 2 };
+                for (int i = 0; i < 6; i++) set_runtime_pin(gen, lcd_pins[i]);
+                break;
+            }
+            
+            case TOKEN_REPEAT:
+            case TOKEN_FOREVER: {
+                Token times = token;
+                if (token.type == TOKEN_REPEAT) times = get_next_token(lexer);
+                if (get_next_token(lexer).type != TOKEN_LBRACE) break;
+                
+                // Running the body once or more ends like running it once
+                PinEffects body;
+                scan_pin_effects(lexer, gen, &body, 1);
+                if (token.type == TOKEN_REPEAT && (times.type != TOKEN_NUMBER || times.number <= 0)) {
+                    for (int i = 0; i < PIN_STATE_COUNT; i++) {
+                        if (body.kind[i] == EFFECT_SET) body.kind[i] = EFFECT_MAYBE;
+                    }
+                }
+                pin_effects_then(effects, &body);
+                break;
+            }
+            
+            case TOKEN_DEFINE: {
+                // The body becomes a function and leaves the caller's pins alone
+                PinEffects body;
+                while ((token = get_next_token(lexer)).type != TOKEN_LBRACE && token.type != TOKEN_EOF) {}
+                if (token.type == TOKEN_LBRACE) scan_pin_effects(lexer, gen, &body, 1);
+                break;
+            }
+            
+            case TOKEN_DO:
+                for (int i = 0; i < PIN_STATE_COUNT; i++) pin_effect(effects, i, EFFECT_SET, PIN_UNKNOWN);
+                break;
+            
+            default:
+                break;
+        }
+    }
+}
+
+// State on entry to a loop body (the lexer is just past its '{'). Since every
+// effect is a set or a maybe-set, join(before, body(before)) is already the
+// fixed point of join(before, body(entry)).
+PinLevels loop_entry_levels(Lexer* lexer, ArduinoGen* gen) {
+    int pos = lexer->pos;
+    int error_count = lexer->error_count;
+    PinEffects body;
+    PinLevels entry = gen->pins;
+    
+    scan_pin_effects(lexer, gen, &body, 1);
+    lexer->pos = pos;   // sync_position() rewinds line/column
+    lexer->error_count = error_count;
+    
+    pin_effects_apply(&body, &entry);
+    pin_levels_join(&entry, &gen->pins);
+    return entry;
+}
+
 // Forward declarations
 void parse_statement(Lexer* lexer, ArduinoGen* gen);
-void parse_block(Lexer* lexer, ArduinoGen* gen);
 
 void parse_block(Lexer* lexer, ArduinoGen* gen) {
     Token token;
@@ -374,23 +1397,501 @@ void parse_block(Lexer* lexer, ArduinoGen* gen) {
     }
 }
 
-void parse_statement(Lexer* lexer, ArduinoGen* gen) {
+// ============================================================================
+// USER-DEFINED PROCEDURES
+//   define dance [param ...] { ... }   ->  void proc_dance(int arg_param, ...) { ... }
+//   do dance [value ...]               ->  proc_dance(value, ...);
+// Bodies are emitted once into gen->functions, so flash grows with the number
+// of distinct behaviors rather than the number of times they are used.
+// Calls may come before the define; arity is checked when both are known.
+// ============================================================================
+
+// A count/duration/angle argument: a number, or a parameter inside a define
+// body. Writes the C expression to out and returns 1 for a plain number.
+int value_argument(Lexer* lexer, ArduinoGen* gen, Token token, char* out, size_t size) {
+    Procedure* procedure = gen->current_procedure;
+    
+    if (token.type == TOKEN_NUMBER) {
+        snprintf(out, size, "%d", token.number);
+        return 1;
+    }
+    for (int i = 0; procedure && i < procedure->param_count; i++) {
+        if (strcmp(procedure->params[i], token.value) == 0) {
+            snprintf(out, size, "arg_%.63s", token.value);
+            return 0;
+        }
+    }
+    
+    char message[320];
+    snprintf(message, sizeof(message), "Expected a number but found '%s'", token.value);
+    add_error_at(lexer, token.line, token.column, message);
+    snprintf(out, size, "0");
+    return 1;
+}
+
+// Pins stay plain numbers, even inside a define: setup() needs to know every
+// pin at compile time. Returns 0 (after an error) for anything else.
+int pin_argument(Lexer* lexer, ArduinoGen* gen, Token token) {
+    Procedure* procedure = gen->current_procedure;
+    char message[320];
+    
+    if (token.type == TOKEN_NUMBER) return 1;
+    for (int i = 0; procedure && i < procedure->param_count; i++) {
+        if (strcmp(procedure->params[i], token.value) == 0) {
+            snprintf(message, sizeof(message), "'%.63s' can't be used as a pin; pins must be numbers", token.value);
+            add_error_at(lexer, token.line, token.column, message);
+            return 0;
+        }
+    }
+    snprintf(message, sizeof(message), "Expected a pin number but found '%.63s'", token.value);
+    add_error_at(lexer, token.line, token.column, message);
+    return 0;
+}
+
+Procedure* find_procedure(ArduinoGen* gen, const char* name) {
+    for (int i = 0; i < gen->procedure_count; i++) {
+        if (strcmp(gen->procedures[i].name, name) == 0) return &gen->procedures[i];
+    }
+    if (gen->procedure_count >= MAX_PROCEDURES) return NULL;
+    
+    Procedure* procedure = &gen->procedures[gen->procedure_count++];
+    memset(procedure, 0, sizeof(Procedure));
+    procedure->call_arity = -1;
+    snprintf(procedure->name, sizeof(procedure->name), "%.63s", name);
+    return procedure;
+}
+
+// Procedure names are plain words that are not already commands
+Procedure* procedure_name(Lexer* lexer, ArduinoGen* gen, Token name) {
+    char message[320];
+    
+    if (name.type != TOKEN_PIN || !(isalpha((unsigned char)name.value[0]) || name.value[0] == '_')) {
+        snprintf(message, sizeof(message), "'%s' can't be used as a name", name.value);
+        add_error_at(lexer, name.line, name.column, message);
+        return NULL;
+    }
+    
+    Procedure* procedure = find_procedure(gen, name.value);
+    if (!procedure) add_error_at(lexer, name.line, name.column, "Too many defines");
+    return procedure;
+}
+
+void procedure_signature(Procedure* procedure, char* out, size_t size) {
+    int len = snprintf(out, size, "void proc_%s(", procedure->name);
+    for (int i = 0; i < procedure->param_count; i++) {
+        len += snprintf(out + len, size - len, "%sint arg_%s", i ? ", " : "", procedure->params[i]);
+    }
+    snprintf(out + len, size - len, ")");
+}
+
+void parse_define(Lexer* lexer, ArduinoGen* gen) {
+    Token name = get_next_token(lexer);
+    char code[512];
+    
+    if (gen->current_procedure || gen->indent_level != 1) {
+        add_error_at(lexer, name.line, name.column, "define must be at the top of the program");
+        return;
+    }
+    
+    Procedure* procedure = procedure_name(lexer, gen, name);
+    if (!procedure) return;
+    if (procedure->defined) {
+        snprintf(code, sizeof(code), "'%s' is already defined", procedure->name);
+        add_error_at(lexer, name.line, name.column, code);
+        return;
+    }
+    
+    Token token;
+    while ((token = get_next_token(lexer)).type == TOKEN_PIN) {
+        if (procedure->param_count == MAX_PROCEDURE_PARAMS) {
+            add_error_at(lexer, token.line, token.column, "Too many values for one define");
+            continue;
+        }
+        snprintf(procedure->params[procedure->param_count++], 64, "%.63s", token.value);
+    }
+    if (token.type != TOKEN_LBRACE) {
+        add_error(lexer, "Expected '{' after define name");
+        return;
+    }
+    
+    if (procedure->call_arity >= 0 && procedure->call_arity != procedure->param_count) {
+        snprintf(code, sizeof(code), "'%s' needs %d value(s) but was called with %d",
+                 procedure->name, procedure->param_count, procedure->call_arity);
+        add_error_at(lexer, procedure->call_line, procedure->call_column, code);
+    }
+    procedure->defined = 1;
+    
+    // Emit the body into its own function instead of loop(); it can be called
+    // from anywhere, so nothing is known about the pins when it starts
+    PinLevels caller_pins = gen->pins;
+    pin_levels_reset(&gen->pins, PIN_UNKNOWN);
+    gen->current_procedure = procedure;
+    gen->code = gen->functions;
+    
+    procedure_signature(procedure, code, sizeof(code));
+    append_code(gen, gen->functions, code);
+    append_code(gen, gen->functions, " {\n");
+    parse_block(lexer, gen);
+    append_code(gen, gen->functions, "}\n\n");
+    
+    gen->code = gen->loop_code;
+    gen->current_procedure = NULL;
+    gen->pins = caller_pins;
+}
+
+void parse_call(Lexer* lexer, ArduinoGen* gen) {
+    Token name = get_next_token(lexer);
+    Procedure* procedure = procedure_name(lexer, gen, name);
+    char code[512];
+    char value[80];
+    int arity = 0;
+    
+    if (!procedure) return;
+    int len = snprintf(code, sizeof(code), "proc_%s(", procedure->name);
+    
+    // Arguments run until the next command word
+    for (;;) {
+        int pos = lexer->pos;
+        Token argument = get_next_token(lexer);
+        if (argument.type != TOKEN_NUMBER &&
+            !(argument.type == TOKEN_PIN && gen->current_procedure)) {
+            lexer->pos = pos;  // sync_position() rewinds line/column
+            break;
+        }
+        value_argument(lexer, gen, argument, value, sizeof(value));
+        len += snprintf(code + len, sizeof(code) - len, "%s%s", arity++ ? ", " : "", value);
+    }
+    snprintf(code + len, sizeof(code) - len, ");  // do %s", procedure->name);
+    pin_levels_reset(&gen->pins, PIN_UNKNOWN);
+    
+    int expected = procedure->defined ? procedure->param_count : procedure->call_arity;
+    if (expected >= 0 && expected != arity) {
+        char message[320];
+        snprintf(message, sizeof(message), "'%s' needs %d value(s), not %d", procedure->name, expected, arity);
+        add_error_at(lexer, name.line, name.column, message);
+    } else if (procedure->call_arity < 0) {
+        procedure->call_arity = arity;
+        procedure->call_line = name.line;
+        procedure->call_column = name.column;
+    }
+    
+    add_line_arduino(gen, gen->code, code);
+}
+
+// ============================================================================
+// MOTORS
+//   motor left 5 7 8         H-bridge with speed (enable) pin 5, direction pins 7/8
+//   forward left 80          Speed 0-100; backward runs the other way
+//   stop left
+// Speed goes to the enable pin with analogWrite, so it must be a hardware PWM
+// pin. Commands only set a target; motor_update() ramps each motor toward it
+// from yield(), so driving never holds up sensing or steering.
+// ============================================================================
+
+static const char* motor_runtime =
+    "int16_t motor_target[MOTOR_COUNT];   // PWM duty -255..255, negative = backward\n"
+    "int16_t motor_duty[MOTOR_COUNT];\n"
+    "unsigned long motor_stepped_at = 0;\n"
+    "\n"
+    "void motor_begin() {\n"
+    "  for (uint8_t i = 0; i < MOTOR_COUNT; i++) {\n"
+    "    pinMode(motor_enable[i], OUTPUT);\n"
+    "    pinMode(motor_in1[i], OUTPUT);\n"
+    "    pinMode(motor_in2[i], OUTPUT);\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "// Move every motor one step toward its target; never waits. A motor that\n"
+    "// changes direction ramps down to 0 before the H-bridge is flipped.\n"
+    "void motor_update() {\n"
+    "  unsigned long now = millis();\n"
+    "  if (now - motor_stepped_at < MOTOR_RAMP_MS) return;\n"
+    "  motor_stepped_at = now;\n"
+    "  for (uint8_t i = 0; i < MOTOR_COUNT; i++) {\n"
+    "    int16_t duty = motor_duty[i];\n"
+    "    int16_t target = motor_target[i];\n"
+    "    if (duty == target) continue;\n"
+    "    if ((duty > 0 && target < 0) || (duty < 0 && target > 0)) target = 0;\n"
+    "    if (duty < target) {\n"
+    "      duty = duty + MOTOR_RAMP_STEP < target ? duty + MOTOR_RAMP_STEP : target;\n"
+    "    } else {\n"
+    "      duty = duty - MOTOR_RAMP_STEP > target ? duty - MOTOR_RAMP_STEP : target;\n"
+    "    }\n"
+    "    if ((duty > 0) != (motor_duty[i] > 0) || (duty < 0) != (motor_duty[i] < 0)) {\n"
+    "      digitalWrite(motor_in1[i], duty > 0 ? HIGH : LOW);\n"
+    "      digitalWrite(motor_in2[i], duty < 0 ? HIGH : LOW);\n"
+    "    }\n"
+    "    analogWrite(motor_enable[i], duty < 0 ? -duty : duty);\n"
+    "    motor_duty[i] = duty;\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "void motor_set(uint8_t i, int16_t target) {\n"
+    "  motor_target[i] = target;\n"
+    "  motor_update();\n"
+    "}\n\n";
+
+// analogWrite() only has hardware PWM on these Uno pins
+int is_pwm_pin(int pin) {
+    return pin == 3 || pin == 5 || pin == 6 || pin == 9 || pin == 10 || pin == 11;
+}
+
+int motor_ramp_ms(ArduinoGen* gen) {
+    return gen->options.motor_ramp_ms > 0 ? gen->options.motor_ramp_ms : DEFAULT_MOTOR_RAMP_MS;
+}
+
+// Duty change per MOTOR_RAMP_MS step, so 0 -> 255 takes motor_ramp_ms()
+int motor_ramp_step(ArduinoGen* gen) {
+    int step = (255 * MOTOR_RAMP_MS + motor_ramp_ms(gen) - 1) / motor_ramp_ms(gen);
+    return step < 255 ? step : 255;
+}
+
+int find_motor(ArduinoGen* gen, const char* name) {
+    for (int i = 0; i < gen->motor_count; i++) {
+        if (strcmp(gen->motors[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Pins already taken by another motor; 0 when free
+int motor_pin_taken(ArduinoGen* gen, int pin) {
+    for (int i = 0; i < gen->motor_count; i++) {
+        Motor* motor = &gen->motors[i];
+        if (motor->enable_pin == pin || motor->in1_pin == pin || motor->in2_pin == pin) return 1;
+    }
+    return 0;
+}
+
+// motor <name> <enable> <in1> <in2>
+void parse_motor(Lexer* lexer, ArduinoGen* gen) {
+    Token name = get_next_token(lexer);
+    Token enable = get_next_token(lexer);
+    Token in1 = get_next_token(lexer);
+    Token in2 = get_next_token(lexer);
+    char message[320];
+    
+    if (name.type != TOKEN_PIN || !(isalpha((unsigned char)name.value[0]) || name.value[0] == '_')) {
+        snprintf(message, sizeof(message), "'%s' can't be used as a name", name.value);
+        add_error_at(lexer, name.line, name.column, message);
+        return;
+    }
+    if (enable.type != TOKEN_NUMBER || in1.type != TOKEN_NUMBER || in2.type != TOKEN_NUMBER) {
+        add_error_at(lexer, name.line, name.column, "A motor needs a speed pin and two direction pins");
+        return;
+    }
+    
+    int index = find_motor(gen, name.value);
+    if (index >= 0) {
+        Motor* motor = &gen->motors[index];
+        if (motor->enable_pin != enable.number || motor->in1_pin != in1.number || motor->in2_pin != in2.number) {
+            snprintf(message, sizeof(message), "Motor '%s' is already on pins %d, %d and %d",
+                     motor->name, motor->enable_pin, motor->in1_pin, motor->in2_pin);
+            add_error_at(lexer, name.line, name.column, message);
+        }
+        return;
+    }
+    
+    if (!is_pwm_pin(enable.number)) {
+        snprintf(message, sizeof(message), "Pin %d can't set motor speed; use a PWM pin (3, 5, 6, 9, 10 or 11)",
+                 enable.number);
+        add_error_at(lexer, enable.line, enable.column, message);
+        return;
+    }
+    // 0 and 1 carry Serial, which every sketch starts
+    for (int i = 0; i < 2; i++) {
+        Token pin = i ? in2 : in1;
+        if (pin.number >= 2 && pin.number <= 19) continue;
+        snprintf(message, sizeof(message), "Pin %d can't set motor direction; use pins 2-13 or A0-A5 (14-19)",
+                 pin.number);
+        add_error_at(lexer, pin.line, pin.column, message);
+        return;
+    }
+    if (enable.number == in1.number || enable.number == in2.number || in1.number == in2.number) {
+        add_error_at(lexer, enable.line, enable.column, "A motor needs three different pins");
+        return;
+    }
+    if (motor_pin_taken(gen, enable.number) || motor_pin_taken(gen, in1.number) || motor_pin_taken(gen, in2.number)) {
+        add_error_at(lexer, enable.line, enable.column, "These pins are already used by another motor");
+        return;
+    }
+    if (gen->motor_count == MAX_MOTORS) {
+        add_error_at(lexer, name.line, name.column, "Too many motors");
+        return;
+    }
+    
+    Motor* motor = &gen->motors[gen->motor_count++];
+    snprintf(motor->name, sizeof(motor->name), "%.63s", name.value);
+    motor->enable_pin = enable.number;
+    motor->in1_pin = in1.number;
+    motor->in2_pin = in2.number;
+    motor->line = name.line;
+    motor->column = name.column;
+    add_pin_usage(gen, enable.number);
+    add_pin_usage(gen, in1.number);
+    add_pin_usage(gen, in2.number);
+}
+
+// forward/backward <name> <speed 0-100>, stop <name>
+void parse_motor_command(Lexer* lexer, ArduinoGen* gen, TokenType type) {
+    Token name = get_next_token(lexer);
+    char code[512];
+    char speed[80];
+    char duty[128];
+    int constant = 1;
+    
+    int index = find_motor(gen, name.value);
+    if (index < 0) {
+        snprintf(code, sizeof(code), "Unknown motor '%.63s' (add: motor %.63s <speed pin> <pin> <pin>)",
+                 name.value, name.value);
+        add_error_at(lexer, name.line, name.column, code);
+        return;
+    }
+    Motor* motor = &gen->motors[index];
+    
+    if (type == TOKEN_MOTOR_STOP) {
+        snprintf(code, sizeof(code), "motor_set(%d, 0);  // Stop motor %s", index, motor->name);
+        add_line_arduino(gen, gen->code, code);
+        snprintf(code, sizeof(code), "🛑 Motor %s stopping", motor->name);
+        emit_serial_message(gen, gen->code, code);
+        return;
+    }
+    
+    Token value = get_next_token(lexer);
+    constant = value_argument(lexer, gen, value, speed, sizeof(speed));
+    const char* sign = type == TOKEN_MOTOR_BACKWARD ? "-" : "";   // Backward is negative duty
+    const char* direction = type == TOKEN_MOTOR_BACKWARD ? "backward" : "forward";
+    if (constant) {
+        if (value.number < 0 || value.number > 100) {
+            add_error_at(lexer, value.line, value.column, "Motor speed must be 0 to 100");
+            return;
+        }
+        snprintf(duty, sizeof(duty), "%s%d", sign, value.number * 255 / 100);
+    } else {
+        snprintf(duty, sizeof(duty), *sign ? "-(constrain(%s, 0, 100) * 255 / 100)" : "constrain(%s, 0, 100) * 255 / 100",
+                 speed);
+    }
+    
+    snprintf(code, sizeof(code), "motor_set(%d, %s);  // Motor %s %s at %s%%", index, duty, motor->name, direction, speed);
+    add_line_arduino(gen, gen->code, code);
+    snprintf(code, sizeof(code), "🚗 Motor %s %s at ", motor->name, direction);
+    emit_serial_argument(gen, gen->code, code, speed, "%", constant);
+}
+
+// The command that already drives a pin, other than a motor (or a distance
+// sensor when sonars is 0); NULL when it is free
+const char* pin_user(ArduinoGen* gen, int pin, int sonars) {
+    if (gen->has_lcd && (pin == 12 || pin == 11 || pin == 5 || pin == 4 || pin == 3 || pin == 2)) return "print_lcd";
+    for (int i = 0; sonars && i < gen->sonar_count; i++) {
+        if (gen->sonar_trig[i] == pin || gen->sonar_echo[i] == pin) return "read_distance";
+    }
+    for (int i = 0; i < gen->temp_count; i++) {
+        if (gen->temp_pins[i] == pin) return "read_temperature";
+    }
+    if (pin < 0 || pin >= PIN_STATE_COUNT) return NULL;
+    if (gen->servo_pins[pin]) return "move_servo";
+    if (gen->output_pins[pin]) return "turn_on/turn_off/blink/beep";
+    return NULL;
+}
+
+// Motors can be connected before or after the other commands, so their pins
+// are checked once the whole program is parsed. Servo takes Timer1 (PWM on 9
+// and 10) and tone() takes Timer2 (3 and 11).
+void check_motor_pins(Lexer* lexer, ArduinoGen* gen) {
+    char message[320];
+    
+    for (int i = 0; i < gen->motor_count; i++) {
+        Motor* motor = &gen->motors[i];
+        int pins[3] = { motor->enable_pin, motor->in1_pin, motor->in2_pin };
+        int pin = motor->enable_pin;
+        const char* user = NULL;
+        
+        for (int j = 0; j < 3 && !user; j++) {
+            pin = pins[j];
+            user = pin_user(gen, pin, 1);
+        }
+        if (user) {
+            snprintf(message, sizeof(message), "Motor '%s' can't use pin %d; %s already uses it",
+                     motor->name, pin, user);
+            add_error_at(lexer, motor->line, motor->column, message);
+            continue;
+        }
+        
+        pin = motor->enable_pin;
+        if (gen->has_servo && (pin == 9 || pin == 10)) user = "move_servo";
+        if (gen->has_tone && (pin == 3 || pin == 11)) user = "beep";
+        if (!user) continue;
+        
+        snprintf(message, sizeof(message), "Motor '%s' can't use pin %d for speed together with %s; try pin 5 or 6",
+                 motor->name, pin, user);
+        add_error_at(lexer, motor->line, motor->column, message);
+    }
+}
+
+// A distance sensor's echo pin must stay an input and its trig pin belongs to
+// the sonar runtime; motors are already checked against both
+void check_sonar_pins(Lexer* lexer, ArduinoGen* gen) {
+    char message[320];
+    
+    for (int i = 0; i < gen->sonar_count; i++) {
+        int pins[2] = { gen->sonar_trig[i], gen->sonar_echo[i] };
+        
+        for (int j = 0; j < 2; j++) {
+            const char* user = pin_user(gen, pins[j], 0);
+            if (!user) continue;
+            snprintf(message, sizeof(message), "Distance sensor %d can't use pin %d; %s already uses it",
+                     i, pins[j], user);
+            add_error_at(lexer, gen->sonar_line[i], gen->sonar_column[i], message);
+            break;
+        }
+    }
+}
+
+// The pin tables need every motor, so the runtime is written once parsing is done
+void emit_motor_runtime(ArduinoGen* gen) {
+    char code[256];
+    
+    if (gen->motor_count == 0) return;
+    
+    append_code(gen, gen->globals, "// Motors: H-bridge speed by PWM, ramped in the background\n");
+    snprintf(code, sizeof(code), "#define MOTOR_COUNT %d\n#define MOTOR_RAMP_MS %d\n#define MOTOR_RAMP_STEP %d\n",
+             gen->motor_count, MOTOR_RAMP_MS, motor_ramp_step(gen));
+    append_code(gen, gen->globals, code);
+    for (int table = 0; table < 3; table++) {
+        static const char* names[] = { "enable", "in1", "in2" };
+        int len = snprintf(code, sizeof(code), "const uint8_t motor_%s[MOTOR_COUNT] = {", names[table]);
+        for (int i = 0; i < gen->motor_count; i++) {
+            Motor* motor = &gen->motors[i];
+            int pin = table == 0 ? motor->enable_pin : table == 1 ? motor->in1_pin : motor->in2_pin;
+            len += snprintf(code + len, sizeof(code) - len, "%s%d", i ? ", " : "", pin);
+        }
+        snprintf(code + len, sizeof(code) - len, "};\n");
+        append_code(gen, gen->globals, code);
+    }
+    append_code(gen, gen->globals, motor_runtime);
+    add_line_arduino(gen, gen->setup_code, "motor_begin();");
+}
+
+void parse_statement(Lexer* lexer, ArduinoGen* gen) {
     Token token = get_next_token(lexer);
+    int profiled = gen->options.profile && is_profiled_statement(token.type);
+    
+    if (profiled) begin_profiled_statement(gen, token.line);
     
     switch (token.type) {
         case TOKEN_TURN_ON: {
             Token pin = get_next_token(lexer);
             char code[256];
             
-            add_pin_usage(gen, pin.number);
-            snprintf(code, sizeof(code), "pinMode(%d, OUTPUT);", pin.number);
-            add_line_arduino(gen, gen->setup_code, code);
-            
-            snprintf(code, sizeof(code), "digitalWrite(%d, HIGH);  // Turn on pin %d", pin.number, pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            if (!pin_argument(lexer, gen, pin)) break;
+            use_output_pin(gen, pin.number);
+            if (pin_level(gen, pin.number) != PIN_HIGH) {
+                snprintf(code, sizeof(code), "digitalWrite(%d, HIGH);  // Turn on pin %d", pin.number, pin.number);
+                add_line_arduino(gen, gen->code, code);
+                set_pin_level(gen, pin.number, PIN_HIGH);
+            }
             
-            snprintf(code, sizeof(code), "Serial.println(\" Pin %d turned ON\");", pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            snprintf(code, sizeof(code), "%d", pin.number);
+            emit_serial_argument(gen, gen->code, " Pin ", code, " turned ON", 1);
             break;
         }
         
@@ -398,15 +1899,16 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             Token pin = get_next_token(lexer);
             char code[256];
             
-            add_pin_usage(gen, pin.number);
-            snprintf(code, sizeof(code), "pinMode(%d, OUTPUT);", pin.number);
-            add_line_arduino(gen, gen->setup_code, code);
-            
-            snprintf(code, sizeof(code), "digitalWrite(%d, LOW);  // Turn off pin %d", pin.number, pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            if (!pin_argument(lexer, gen, pin)) break;
+            use_output_pin(gen, pin.number);
+            if (pin_level(gen, pin.number) != PIN_LOW) {
+                snprintf(code, sizeof(code), "digitalWrite(%d, LOW);  // Turn off pin %d", pin.number, pin.number);
+                add_line_arduino(gen, gen->code, code);
+                set_pin_level(gen, pin.number, PIN_LOW);
+            }
             
-            snprintf(code, sizeof(code), "Serial.println(\"💡 Pin %d turned OFF\");", pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            snprintf(code, sizeof(code), "%d", pin.number);
+            emit_serial_argument(gen, gen->code, "💡 Pin ", code, " turned OFF", 1);
             break;
         }
         
@@ -415,27 +1917,34 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             Token times = get_next_token(lexer);
             char code[512];
             
-            add_pin_usage(gen, pin.number);
-            snprintf(code, sizeof(code), "pinMode(%d, OUTPUT);", pin.number);
-            add_line_arduino(gen, gen->setup_code, code);
+            if (!pin_argument(lexer, gen, pin)) break;
+            use_output_pin(gen, pin.number);
             
-            snprintf(code, sizeof(code), "// Blink pin %d for %d times", pin.number, times.number);
-            add_line_arduino(gen, gen->loop_code, code);
-            snprintf(code, sizeof(code), "for(int i = 0; i < %d; i++) {", times.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            char count[80];
+            int constant = value_argument(lexer, gen, times, count, sizeof(count));
+            
+            snprintf(code, sizeof(code), "// Blink pin %d for %s times", pin.number, count);
+            add_line_arduino(gen, gen->code, code);
+            snprintf(code, sizeof(code), "for(int i = 0; i < %s; i++) {", count);
+            add_line_arduino(gen, gen->code, code);
             
             gen->indent_level++;
             snprintf(code, sizeof(code), "digitalWrite(%d, HIGH);", pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
-            add_line_arduino(gen, gen->loop_code, "delay(500);");
+            add_line_arduino(gen, gen->code, code);
+            add_line_arduino(gen, gen->code, "delay(500);");
             snprintf(code, sizeof(code), "digitalWrite(%d, LOW);", pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
-            add_line_arduino(gen, gen->loop_code, "delay(500);");
+            add_line_arduino(gen, gen->code, code);
+            add_line_arduino(gen, gen->code, "delay(500);");
             gen->indent_level--;
             
-            add_line_arduino(gen, gen->loop_code, "}");
-            snprintf(code, sizeof(code), "Serial.println(\" Pin %d blinked %d times\");", pin.number, times.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            add_line_arduino(gen, gen->code, "}");
+            if (constant && times.number > 0) {
+                set_pin_level(gen, pin.number, PIN_LOW);
+            } else if (pin_level(gen, pin.number) != PIN_LOW) {
+                set_pin_level(gen, pin.number, PIN_UNKNOWN);   // Maybe zero blinks
+            }
+            snprintf(code, sizeof(code), " Pin %d blinked ", pin.number);
+            emit_serial_argument(gen, gen->code, code, count, " times", constant);
             break;
         }
         
@@ -444,17 +1953,21 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             Token duration = get_next_token(lexer);
             char code[256];
             
-            add_pin_usage(gen, pin.number);
-            snprintf(code, sizeof(code), "pinMode(%d, OUTPUT);", pin.number);
-            add_line_arduino(gen, gen->setup_code, code);
+            if (!pin_argument(lexer, gen, pin)) break;
+            use_output_pin(gen, pin.number);
+            
+            char length[80];
+            int constant = value_argument(lexer, gen, duration, length, sizeof(length));
             
-            snprintf(code, sizeof(code), "tone(%d, 1000, %d);  // Beep on pin %d", pin.number, duration.number, pin.number);
-            add_line_arduino(gen, gen->loop_code, code);
-            snprintf(code, sizeof(code), "delay(%d);", duration.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            snprintf(code, sizeof(code), "tone(%d, 1000, %s);  // Beep on pin %d", pin.number, length, pin.number);
+            add_line_arduino(gen, gen->code, code);
+            snprintf(code, sizeof(code), "delay(%s);", length);
+            add_line_arduino(gen, gen->code, code);
+            set_pin_level(gen, pin.number, PIN_UNKNOWN);   // tone() drives the pin
+            gen->has_tone = 1;
             
-            snprintf(code, sizeof(code), "Serial.println(\"🔊 Beep on pin %d for %dms\");", pin.number, duration.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            snprintf(code, sizeof(code), "🔊 Beep on pin %d for ", pin.number);
+            emit_serial_argument(gen, gen->code, code, length, "ms", constant);
             break;
         }
         
@@ -462,29 +1975,31 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             Token pin = get_next_token(lexer);
             char code[512];
             
-            if (!gen->has_temperature) {
-                strcat(gen->includes, "#include <DHT.h>\n");
-                snprintf(code, sizeof(code), "#define DHT_PIN %d\n", pin.number);
-                strcat(gen->includes, code);
-                strcat(gen->includes, "#define DHT_TYPE DHT22\n");
-                strcat(gen->includes, "DHT dht(DHT_PIN, DHT_TYPE);\n\n");
-                
-                add_line_arduino(gen, gen->setup_code, "dht.begin();");
-                gen->has_temperature = 1;
-            }
+            if (!pin_argument(lexer, gen, pin)) break;
+            int sensor = temp_index(lexer, gen, pin);
+            if (sensor < 0) break;
             
-            add_line_arduino(gen, gen->loop_code, "float temperature = dht.readTemperature();");
-            add_line_arduino(gen, gen->loop_code, "if (!isnan(temperature)) {");
+            snprintf(code, sizeof(code), "// Read temperature (sensor %d, cached for TEMP_SAMPLE_MS)", sensor);
+            add_line_arduino(gen, gen->code, code);
+            if (gen->options.fixed_point) {
+                snprintf(code, sizeof(code), "if (temp_read(%d) != TEMP_ERROR) {", sensor);
+            } else {
+                snprintf(code, sizeof(code), "if (!isnan(temp_read(%d))) {", sensor);
+            }
+            add_line_arduino(gen, gen->code, code);
             gen->indent_level++;
-            add_line_arduino(gen, gen->loop_code, "Serial.print(\"🌡️  Temperature: \");");
-            add_line_arduino(gen, gen->loop_code, "Serial.print(temperature);");
-            add_line_arduino(gen, gen->loop_code, "Serial.println(\"°C\");");
+            snprintf(code, sizeof(code), "temp_read(%d)", sensor);
+            if (gen->options.fixed_point) {
+                emit_serial_tenths(gen, gen->code, "🌡️  Temperature: ", code, "°C");
+            } else {
+                emit_serial_value(gen, gen->code, "🌡️  Temperature: ", code, "°C", 10);
+            }
             gen->indent_level--;
-            add_line_arduino(gen, gen->loop_code, "} else {");
+            add_line_arduino(gen, gen->code, "} else {");
             gen->indent_level++;
-            add_line_arduino(gen, gen->loop_code, "Serial.println(\"❌ Temperature sensor error\");");
+            emit_serial_message(gen, gen->code, "❌ Temperature sensor error");
             gen->indent_level--;
-            add_line_arduino(gen, gen->loop_code, "}");
+            add_line_arduino(gen, gen->code, "}");
             break;
         }
         
@@ -493,30 +2008,18 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             Token echo_pin = get_next_token(lexer);
             char code[512];
             
-            if (!gen->has_ultrasonic) {
-                snprintf(code, sizeof(code), "#define TRIG_PIN %d\n", trig_pin.number);
-                strcat(gen->includes, code);
-                snprintf(code, sizeof(code), "#define ECHO_PIN %d\n\n", echo_pin.number);
-                strcat(gen->includes, code);
-                
-                snprintf(code, sizeof(code), "pinMode(TRIG_PIN, OUTPUT);");
-                add_line_arduino(gen, gen->setup_code, code);
-                snprintf(code, sizeof(code), "pinMode(ECHO_PIN, INPUT);");
-                add_line_arduino(gen, gen->setup_code, code);
-                gen->has_ultrasonic = 1;
-            }
+            if (!pin_argument(lexer, gen, trig_pin) || !pin_argument(lexer, gen, echo_pin)) break;
+            int sonar = sonar_index(lexer, gen, trig_pin, echo_pin);
+            if (sonar < 0) break;
             
-            add_line_arduino(gen, gen->loop_code, "// Read ultrasonic distance");
-            add_line_arduino(gen, gen->loop_code, "digitalWrite(TRIG_PIN, LOW);");
-            add_line_arduino(gen, gen->loop_code, "delayMicroseconds(2);");
-            add_line_arduino(gen, gen->loop_code, "digitalWrite(TRIG_PIN, HIGH);");
-            add_line_arduino(gen, gen->loop_code, "delayMicroseconds(10);");
-            add_line_arduino(gen, gen->loop_code, "digitalWrite(TRIG_PIN, LOW);");
-            add_line_arduino(gen, gen->loop_code, "long duration = pulseIn(ECHO_PIN, HIGH);");
-            add_line_arduino(gen, gen->loop_code, "float distance = duration * 0.034 / 2;");
-            add_line_arduino(gen, gen->loop_code, "Serial.print(\"📏 Distance: \");");
-            add_line_arduino(gen, gen->loop_code, "Serial.print(distance);");
-            add_line_arduino(gen, gen->loop_code, "Serial.println(\" cm\");");
+            snprintf(code, sizeof(code), "// Read ultrasonic distance (sensor %d, measured in the background)", sonar);
+            add_line_arduino(gen, gen->code, code);
+            snprintf(code, sizeof(code), "sonar_distance(%d)", sonar);
+            if (gen->options.fixed_point) {
+                emit_serial_tenths(gen, gen->code, "📏 Distance: ", code, " cm");   // mm = tenths of a cm
+            } else {
+                emit_serial_value(gen, gen->code, "📏 Distance: ", code, " cm", 10);
+            }
             break;
         }
         
@@ -525,19 +2028,24 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             Token angle = get_next_token(lexer);
             char code[256];
             
+            if (!pin_argument(lexer, gen, pin)) break;
             if (!gen->has_servo) {
-                strcat(gen->includes, "#include <Servo.h>\n");
-                strcat(gen->globals, "Servo myServo;\n\n");
+                append_code(gen, gen->includes, "#include <Servo.h>\n");
+                append_code(gen, gen->globals, "Servo myServo;\n\n");
                 gen->has_servo = 1;
             }
             
             snprintf(code, sizeof(code), "myServo.attach(%d);", pin.number);
             add_line_arduino(gen, gen->setup_code, code);
+            if (pin.number >= 0 && pin.number < PIN_STATE_COUNT) gen->servo_pins[pin.number] = 1;
+            set_pin_level(gen, pin.number, PIN_UNKNOWN);
             
-            snprintf(code, sizeof(code), "myServo.write(%d);  // Move servo to %d degrees", angle.number, angle.number);
-            add_line_arduino(gen, gen->loop_code, code);
-            snprintf(code, sizeof(code), "Serial.println(\"🔄 Servo moved to %d degrees\");", angle.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            char degrees[80];
+            int constant = value_argument(lexer, gen, angle, degrees, sizeof(degrees));
+            
+            snprintf(code, sizeof(code), "myServo.write(%s);  // Move servo to %s degrees", degrees, degrees);
+            add_line_arduino(gen, gen->code, code);
+            emit_serial_argument(gen, gen->code, "🔄 Servo moved to ", degrees, " degrees", constant);
             break;
         }
         
@@ -546,35 +2054,35 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             char code[512];
             
             if (!gen->has_lcd) {
-                strcat(gen->includes, "#include <LiquidCrystal.h>\n");
-                strcat(gen->globals, "LiquidCrystal lcd(12, 11, 5, 4, 3, 2);\n\n");
+                append_code(gen, gen->includes, "#include <LiquidCrystal.h>\n");
+                append_code(gen, gen->globals, "LiquidCrystal lcd(12, 11, 5, 4, 3, 2);\n\n");
                 add_line_arduino(gen, gen->setup_code, "lcd.begin(16, 2);");
                 gen->has_lcd = 1;
             }
             
-            add_line_arduino(gen, gen->loop_code, "lcd.clear();");
+            add_line_arduino(gen, gen->code, "lcd.clear();");
             snprintf(code, sizeof(code), "lcd.print(\"%s\");", message.value);
-            add_line_arduino(gen, gen->loop_code, code);
-            snprintf(code, sizeof(code), "Serial.println(\"📺 LCD: %s\");", message.value);
-            add_line_arduino(gen, gen->loop_code, code);
+            add_line_arduino(gen, gen->code, code);
+            snprintf(code, sizeof(code), "📺 LCD: %s", message.value);
+            emit_serial_message(gen, gen->code, code);
             break;
         }
         
         case TOKEN_PRINT_SERIAL: {
             Token message = get_next_token(lexer);
-            char code[256];
             
-            snprintf(code, sizeof(code), "Serial.println(\"%s\");", message.value);
-            add_line_arduino(gen, gen->loop_code, code);
+            emit_serial_message(gen, gen->code, message.value);
             break;
         }
         
         case TOKEN_WAIT: {
             Token time = get_next_token(lexer);
             char code[256];
+            char ms[80];
             
-            snprintf(code, sizeof(code), "delay(%d);  // Wait %d milliseconds", time.number, time.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            value_argument(lexer, gen, time, ms, sizeof(ms));
+            snprintf(code, sizeof(code), "delay(%s);  // Wait %s milliseconds", ms, ms);
+            add_line_arduino(gen, gen->code, code);
             break;
         }
         
@@ -588,14 +2096,23 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
             }
             
             char code[256];
-            snprintf(code, sizeof(code), "for(int i = 0; i < %d; i++) {", times.number);
-            add_line_arduino(gen, gen->loop_code, code);
+            char count[80];
+            value_argument(lexer, gen, times, count, sizeof(count));
+            snprintf(code, sizeof(code), "for(int i = 0; i < %s; i++) {", count);
+            add_line_arduino(gen, gen->code, code);
+            
+            PinLevels before = gen->pins;
+            gen->pins = loop_entry_levels(lexer, gen);
             
             gen->indent_level++;
             parse_block(lexer, gen);
             gen->indent_level--;
             
-            add_line_arduino(gen, gen->loop_code, "}");
+            if (times.type != TOKEN_NUMBER || times.number <= 0) {
+                pin_levels_join(&gen->pins, &before);  // The body may not run at all
+            }
+            
+            add_line_arduino(gen, gen->code, "}");
             break;
         }
         
@@ -607,16 +2124,36 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
                 return;
             }
             
-            add_line_arduino(gen, gen->loop_code, "while(true) {");
+            add_line_arduino(gen, gen->code, "while(true) {");
+            
+            gen->pins = loop_entry_levels(lexer, gen);
             
             gen->indent_level++;
             parse_block(lexer, gen);
             gen->indent_level--;
             
-            add_line_arduino(gen, gen->loop_code, "}");
+            add_line_arduino(gen, gen->code, "}");
             break;
         }
         
+        case TOKEN_MOTOR:
+            parse_motor(lexer, gen);
+            break;
+        
+        case TOKEN_MOTOR_FORWARD:
+        case TOKEN_MOTOR_BACKWARD:
+        case TOKEN_MOTOR_STOP:
+            parse_motor_command(lexer, gen, token.type);
+            break;
+        
+        case TOKEN_DEFINE:
+            parse_define(lexer, gen);
+            break;
+        
+        case TOKEN_DO:
+            parse_call(lexer, gen);
+            break;
+        
         case TOKEN_NEWLINE:
         case TOKEN_EOF:
             break;
@@ -624,12 +2161,136 @@ void parse_statement(Lexer* lexer, ArduinoGen* gen) {
         default:
             break;
     }
+    
+    if (profiled) end_profiled_statement(gen, token.line);
 }
 
 void finalize_arduino_code(ArduinoGen* gen) {
-    strcat(gen->setup_code, "  Serial.println(\" Arduino Kids Program Starting!\");\n");
-    strcat(gen->setup_code, "}\n");
-    strcat(gen->loop_code, "  \n  delay(100);  // Small delay for stability\n}\n");
+    emit_sonar_runtime(gen);
+    emit_temp_runtime(gen);
+    emit_motor_runtime(gen);
+    emit_background_tasks(gen);
+    emit_serial_message(gen, gen->setup_code, " Arduino Kids Program Starting!");
+    append_code(gen, gen->setup_code, "}\n");
+    append_code(gen, gen->loop_code, "  \n  delay(100);  // Small delay for stability\n}\n");
+}
+
+void parse_statements(Lexer* lexer, ArduinoGen* gen) {
+    Token token;
+    do {
+        token = get_next_token(lexer);
+        if (token.type == TOKEN_EOF) break;
+        
+        lexer->pos -= strlen(token.value);
+        lexer->column -= strlen(token.value);
+        parse_statement(lexer, gen);
+    } while (token.type != TOKEN_EOF);
+}
+
+// loop() runs again and again, so its entry state is the join of the
+// all-LOW state setup() leaves with whatever loop() itself ends with
+PinLevels loop_function_levels(const char* code, ArduinoGen* gen) {
+    Lexer* lexer = create_lexer((char*)code);
+    PinEffects program;
+    PinLevels after_setup, entry;
+    
+    scan_pin_effects(lexer, gen, &program, 0);
+    free(lexer);
+    
+    pin_levels_reset(&after_setup, PIN_LOW);
+    entry = after_setup;
+    pin_effects_apply(&program, &entry);
+    pin_levels_join(&entry, &after_setup);
+    return entry;
+}
+
+// Parse a whole program into gen and finish its sections; the caller reports
+// and frees the lexer
+Lexer* parse_program(const char* code, ArduinoGen* gen) {
+    Lexer* lexer = create_lexer((char*)code);
+    
+    gen->pins = loop_function_levels(code, gen);
+    parse_statements(lexer, gen);
+    
+    for (int i = 0; i < gen->procedure_count; i++) {
+        Procedure* procedure = &gen->procedures[i];
+        if (!procedure->defined) {
+            char message[320];
+            snprintf(message, sizeof(message), "Unknown name '%s' (add: define %s { ... })",
+                     procedure->name, procedure->name);
+            add_error_at(lexer, procedure->call_line, procedure->call_column, message);
+        }
+    }
+    check_motor_pins(lexer, gen);
+    check_sonar_pins(lexer, gen);
+    
+    finalize_arduino_code(gen);
+    if (gen->log_table_full) {
+        char message[128];
+        snprintf(message, sizeof(message), "Too many different messages for --binary-log (at most %d)",
+                 LOG_MAX_MESSAGES);
+        add_error_at(lexer, 1, 1, message);
+    }
+    if (gen->too_long) {
+        add_error_at(lexer, 1, 1, "Program is too long to fit in one sketch; split it up or use define/do");
+    }
+    
+    return lexer;
+}
+
+// Copy part to the end of gen->output; returns the new length
+size_t append_output(ArduinoGen* gen, size_t used, const char* part) {
+    size_t length = strlen(part);
+    memcpy(gen->output + used, part, length + 1);
+    return used + length;
+}
+
+// Create complete Arduino sketch in gen->output from a parsed program
+void assemble_sketch(ArduinoGen* gen) {
+    size_t used = append_output(gen, 0, gen->includes);
+    used = append_output(gen, used, gen->globals);
+    
+    // Prototypes let a procedure call another one defined further down
+    for (int i = 0; i < gen->procedure_count; i++) {
+        char signature[SIGNATURE_SIZE];
+        if (!gen->procedures[i].defined) continue;
+        procedure_signature(&gen->procedures[i], signature, sizeof(signature));
+        used = append_output(gen, used, signature);
+        used = append_output(gen, used, ";\n");
+    }
+    if (gen->procedure_count > 0) used = append_output(gen, used, "\n");
+    used = append_output(gen, used, gen->functions);
+    used = append_output(gen, used, gen->setup_code);
+    append_output(gen, used, gen->loop_code);
+}
+
+// Write through a temp file and rename so readers never see a half-written sketch
+int write_sketch_atomic(const char* path, const char* text) {
+    char temp_path[1024];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    
+    FILE* file = fopen(temp_path, "w");
+    if (!file) return -1;
+    
+    size_t length = strlen(text);
+    int failed = fwrite(text, 1, length, file) != length;
+    failed |= fclose(file) != 0;
+    if (failed || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Read a kid program from disk; returns bytes read or -1
+int read_program_file(const char* path, char* code, size_t size) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    
+    size_t bytes_read = fread(code, 1, size - 1, file);
+    code[bytes_read] = '\0';
+    fclose(file);
+    return (int)bytes_read;
 }
 
 void interpret_arduino_kids(const char* code, int show_details) {
@@ -644,18 +2305,8 @@ void interpret_arduino_kids(const char* code, int show_details) {
         printf("Converting your commands to Arduino code...\n\n");
     }
     
-    Lexer* lexer = create_lexer((char*)code);
     ArduinoGen* gen = create_arduino_gen();
-    
-    Token token;
-    do {
-        token = get_next_token(lexer);
-        if (token.type == TOKEN_EOF) break;
-        
-        lexer->pos -= strlen(token.value);
-        lexer->column -= strlen(token.value);
-        parse_statement(lexer, gen);
-    } while (token.type != TOKEN_EOF);
+    Lexer* lexer = parse_program(code, gen);
     
     if (lexer->error_count > 0) {
         printf("⚠Parsing Errors Found:\n");
@@ -665,13 +2316,7 @@ void interpret_arduino_kids(const char* code, int show_details) {
         printf("\n");
     }
     
-    finalize_arduino_code(gen);
-    
-    // Create complete Arduino sketch
-    strcpy(gen->output, gen->includes);
-    strcat(gen->output, gen->globals);
-    strcat(gen->output, gen->setup_code);
-    strcat(gen->output, gen->loop_code);
+    assemble_sketch(gen);
     
     if (show_details) {
         printf("Generated Arduino Code:\n");
@@ -681,11 +2326,7 @@ void interpret_arduino_kids(const char* code, int show_details) {
     }
     
     // Write Arduino sketch file
-    FILE* file = fopen("arduino_kids_program.ino", "w");
-    if (file) {
-        fprintf(file, "%s", gen->output);
-        fclose(file);
-        
+    if (write_sketch_atomic("arduino_kids_program.ino", gen->output) == 0) {
         if (show_details) {
             printf("Arduino sketch saved as 'arduino_kids_program.ino'\n");
             printf("Upload this file to your Arduino using the Arduino IDE!\n\n");
@@ -701,10 +2342,14 @@ void interpret_arduino_kids(const char* code, int show_details) {
             printf("----------------------\n");
             if (gen->has_servo) printf("   - Servo library (built-in)\n");
             if (gen->has_lcd) printf("   - LiquidCrystal library (built-in)\n");
-            if (gen->has_temperature) printf("   - DHT sensor library (install from Library Manager)\n");
-            if (!gen->has_servo && !gen->has_lcd && !gen->has_temperature) {
+            int needs_dht = gen->temp_count > 0 && !gen->options.fixed_point;
+            if (needs_dht) printf("   - DHT sensor library (install from Library Manager)\n");
+            if (!gen->has_servo && !gen->has_lcd && !needs_dht) {
                 printf("   - No additional libraries needed!\n");
             }
+            printf("\n");
+            
+            print_sampling_summary(gen);
         } else {
             printf(" Arduino code generated successfully!\n");
             printf(" Saved as: arduino_kids_program.ino\n");
@@ -718,64 +2363,410 @@ void interpret_arduino_kids(const char* code, int show_details) {
     free(gen);
 }
 
-// Example programs showcase
-void run_arduino_examples() {
-    printf(" Arduino Kids Programming Language\n");
-    printf("====================================\n");
-    printf(" Professional Educational Compiler for Resume\n");
-    printf("Converts kid-friendly commands to Arduino C++ code\n\n");
+// ============================================================================
+// WATCH MODE
+// Recompiles kid programs the moment an editor saves them (Linux inotify)
+// ============================================================================
+
+#define WATCH_DEBOUNCE_MS 15    // Quiet period that ends a burst of writes
+#define WATCH_MAX_PENDING 32
+
+// Kid programs are plain .txt files (see my_robot.txt)
+int is_program_file(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot != NULL && strcmp(dot, ".txt") == 0;
+}
+
+// <outdir>/<program name>.ino
+void sketch_path_for(const char* source, const char* outdir, char* path, size_t size) {
+    const char* base = strrchr(source, '/');
+    base = base ? base + 1 : source;
+    const char* dot = strrchr(base, '.');
+    int len = dot ? (int)(dot - base) : (int)strlen(base);
+    snprintf(path, size, "%s/%.*s.ino", outdir, len, base);
+}
+
+int compile_watched_file(const char* source, const char* outdir) {
+    char code[4096];
+    char sketch_path[1024];
+    struct timespec start, end;
     
-    printf(" Example 1: Blinking LED\n");
-    printf("--------------------------\n");
-    interpret_arduino_kids(
-        "// Simple LED blink\n"
-        "turn_on 13\n"
-        "wait 1000\n"
-        "turn_off 13\n"
-        "wait 1000\n"
-        "blink 13 5\n"
-        "print \"LED demo complete!\"", 1
-    );
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (read_program_file(source, code, sizeof(code)) < 0) {
+        printf(" [watch] Could not read '%s'\n", source);
+        return -1;
+    }
     
-    printf("\n\nExample 2: Servo Motor Control\n");
-    printf("---------------------------------\n");
-    interpret_arduino_kids(
-        "// Servo sweep\n"
-        "print \"Moving servo motor\"\n"
-        "move_servo 9 0\n"
-        "wait 1000\n"
-        "move_servo 9 90\n"
-        "wait 1000\n"
-        "move_servo 9 180\n"
-        "wait 1000\n"
-        "print \"Servo sweep complete!\"", 1
-    );
+    ArduinoGen* gen = create_arduino_gen();
+    Lexer* lexer = parse_program(code, gen);
+    assemble_sketch(gen);
     
-    printf("\n\nExample 3: Temperature Sensor\n");
-    printf("--------------------------------\n");
-    interpret_arduino_kids(
+    sketch_path_for(source, outdir, sketch_path, sizeof(sketch_path));
+    int result = write_sketch_atomic(sketch_path, gen->output);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 +
+                        (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    if (result == 0) {
+        printf(" [watch] %s -> %s (%.2f ms, %d error(s))\n",
+               source, sketch_path, elapsed_ms, lexer->error_count);
+    } else {
+        printf(" [watch] Could not write '%s'\n", sketch_path);
+    }
+    for (int i = 0; i < lexer->error_count; i++) {
+        printf("   %s\n", lexer->errors[i]);
+    }
+    fflush(stdout);
+    
+    free(lexer);
+    free(gen);
+    return result;
+}
+
+#ifdef __linux__
+// Collect changed file names from one inotify read, skipping duplicates
+void collect_watch_events(int fd, const char* only_name,
+                          char pending[][256], int* pending_count) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+            
+            if (event->len == 0) continue;
+            if (only_name[0] ? strcmp(event->name, only_name) != 0
+                             : !is_program_file(event->name)) continue;
+            
+            int seen = 0;
+            for (int i = 0; i < *pending_count; i++) {
+                if (strcmp(pending[i], event->name) == 0) seen = 1;
+            }
+            if (!seen && *pending_count < WATCH_MAX_PENDING) {
+                snprintf(pending[(*pending_count)++], 256, "%s", event->name);
+            }
+        }
+    }
+}
+
+int watch_and_compile(const char* target, const char* outdir) {
+    struct stat info;
+    char dir[1024];
+    char only_name[256] = "";
+    char source[sizeof(dir) + 256];  // dir + '/' + a file name (at most 255 bytes)
+    
+    if (stat(target, &info) != 0) {
+        printf(" Error: Could not find '%s'\n", target);
+        return 1;
+    }
+    
+    if (S_ISDIR(info.st_mode)) {
+        snprintf(dir, sizeof(dir), "%s", target);
+    } else {
+        // Watch the parent directory: many editors save by renaming a new file over the old one
+        const char* slash = strrchr(target, '/');
+        if (slash) {
+            snprintf(dir, sizeof(dir), "%.*s", (int)(slash - target), target);
+            if (dir[0] == '\0') strcpy(dir, "/");
+        } else {
+            strcpy(dir, ".");
+        }
+        snprintf(only_name, sizeof(only_name), "%s", slash ? slash + 1 : target);
+    }
+    
+    // Start watching before the first build so a save during it is not lost
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        printf(" Error: Could not watch '%s' (%s)\n", dir, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    
+    if (S_ISDIR(info.st_mode)) {
+        DIR* handle = opendir(dir);
+        struct dirent* entry;
+        while (handle && (entry = readdir(handle)) != NULL) {
+            if (!is_program_file(entry->d_name)) continue;
+            snprintf(source, sizeof(source), "%s/%s", dir, entry->d_name);
+            compile_watched_file(source, outdir);
+        }
+        if (handle) closedir(handle);
+    } else {
+        compile_watched_file(target, outdir);
+    }
+    
+    printf(" Watching '%s' for changes, writing sketches to '%s' (Ctrl+C to stop)\n", target, outdir);
+    fflush(stdout);
+    
+    struct pollfd watcher = { .fd = fd, .events = POLLIN };
+    char pending[WATCH_MAX_PENDING][256];
+    
+    for (;;) {
+        if (poll(&watcher, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        
+        // Keep draining until the editor has been quiet for WATCH_DEBOUNCE_MS
+        int pending_count = 0;
+        do {
+            collect_watch_events(fd, only_name, pending, &pending_count);
+        } while (poll(&watcher, 1, WATCH_DEBOUNCE_MS) > 0);
+        
+        for (int i = 0; i < pending_count; i++) {
+            snprintf(source, sizeof(source), "%s/%.255s", dir, pending[i]);
+            compile_watched_file(source, outdir);
+        }
+    }
+    
+    close(fd);
+    return 1;
+}
+#else
+int watch_and_compile(const char* target, const char* outdir) {
+    (void)target;
+    (void)outdir;
+    printf(" Error: --watch needs Linux (inotify)\n");
+    return 1;
+}
+#endif
+
+// ============================================================================
+// PROFILE REPORT
+// Decodes --profile frames captured from the serial port and maps them back
+// to the kid program's source lines
+// ============================================================================
+
+#define PROFILE_MAX_LINES 512
+
+typedef struct {
+    unsigned long calls;
+    unsigned long long total_us;
+    unsigned long max_us;
+} LineProfile;
+
+// Read a whole capture; text from Serial.println may be mixed in with frames
+unsigned char* read_capture_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    
+    size_t capacity = 65536;
+    unsigned char* data = malloc(capacity);
+    size_t bytes_read;
+    *length = 0;
+    
+    while (data && (bytes_read = fread(data + *length, 1, capacity - *length, file)) > 0) {
+        *length += bytes_read;
+        if (*length == capacity) {
+            capacity *= 2;
+            unsigned char* grown = realloc(data, capacity);
+            if (!grown) free(data);
+            data = grown;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+// Returns the frame size if a valid frame starts at data, otherwise 0
+size_t decode_profile_frame(const unsigned char* data, size_t available,
+                            LineProfile* lines, int line_count) {
+    if (available < 4 || data[0] != PROFILE_SYNC_0 || data[1] != PROFILE_SYNC_1) return 0;
+    
+    int count = data[2];
+    size_t frame_size = 3 + (size_t)count * PROFILE_RECORD_BYTES + 1;
+    if (count == 0 || count > PROFILE_RING_SIZE || frame_size > available) return 0;
+    
+    unsigned char checksum = 0;
+    for (size_t i = 3; i < frame_size - 1; i++) checksum += data[i];
+    if (checksum != data[frame_size - 1]) return 0;
+    
+    const unsigned char* record = data + 3;
+    for (int i = 0; i < count; i++, record += PROFILE_RECORD_BYTES) {
+        if ((record[0] | record[1] << 8) > line_count) return 0;
+    }
+    
+    record = data + 3;
+    for (int i = 0; i < count; i++, record += PROFILE_RECORD_BYTES) {
+        int line = record[0] | record[1] << 8;
+        unsigned long elapsed = (unsigned long)record[2] | (unsigned long)record[3] << 8 |
+                                (unsigned long)record[4] << 16 | (unsigned long)record[5] << 24;
+        lines[line].calls++;
+        lines[line].total_us += elapsed;
+        if (elapsed > lines[line].max_us) lines[line].max_us = elapsed;
+    }
+    return frame_size;
+}
+
+int report_profile(const char* program_path, const char* capture_path) {
+    char code[4096];
+    char* source_lines[PROFILE_MAX_LINES + 1];
+    int line_count = 0;
+    
+    if (read_program_file(program_path, code, sizeof(code)) < 0) {
+        printf(" Error: Could not open file '%s'\n", program_path);
+        return 1;
+    }
+    // Keep blank lines so numbering matches Token.line
+    for (char* line = code; line && line_count < PROFILE_MAX_LINES;) {
+        source_lines[++line_count] = line;
+        line = strchr(line, '\n');
+        if (line) *line++ = '\0';
+    }
+    
+    size_t length;
+    unsigned char* data = read_capture_file(capture_path, &length);
+    if (!data) {
+        printf(" Error: Could not read capture '%s'\n", capture_path);
+        return 1;
+    }
+    
+    LineProfile* lines = calloc(line_count + 1, sizeof(LineProfile));
+    int frames = 0;
+    for (size_t pos = 0; pos < length;) {
+        size_t frame_size = decode_profile_frame(data + pos, length - pos, lines, line_count);
+        if (frame_size > 0) {
+            pos += frame_size;
+            frames++;
+        } else {
+            pos++;  // Serial text or a damaged frame: resync on the next sync bytes
+        }
+    }
+    free(data);
+    
+    unsigned long long total_us = 0;
+    int order[PROFILE_MAX_LINES + 1];
+    int ranked = 0;
+    for (int line = 1; line <= line_count; line++) {
+        if (lines[line].calls == 0) continue;
+        total_us += lines[line].total_us;
+        
+        // Insertion sort, hottest line first
+        int slot = ranked++;
+        while (slot > 0 && lines[order[slot - 1]].total_us < lines[line].total_us) {
+            order[slot] = order[slot - 1];
+            slot--;
+        }
+        order[slot] = line;
+    }
+    
+    printf(" Profile of '%s' (%d frames, %llu us measured)\n", program_path, frames, total_us);
+    printf(" Line    Calls     Total us     Avg us     Max us   Share  Source\n");
+    for (int i = 0; i < ranked; i++) {
+        LineProfile* entry = &lines[order[i]];
+        const char* text = source_lines[order[i]];
+        while (isspace((unsigned char)*text)) text++;
+        printf(" %4d %8lu %12llu %10llu %10lu  %5.1f%%  %s\n",
+               order[i], entry->calls, entry->total_us, entry->total_us / entry->calls,
+               entry->max_us, total_us ? 100.0 * entry->total_us / total_us : 0.0, text);
+    }
+    if (ranked == 0) {
+        printf("   No profile samples found. Was the sketch compiled with --profile?\n");
+    }
+    
+    free(lines);
+    return 0;
+}
+
+// ============================================================================
+// BINARY LOG DECODER
+// Turns --binary-log records back into the friendly messages. The string
+// table is rebuilt by compiling the same program again, so pass the same
+// code generation flags that were used for the upload.
+// ============================================================================
+
+int decode_binary_log(const char* program_path, const char* capture_path) {
+    char code[4096];
+    
+    if (read_program_file(program_path, code, sizeof(code)) < 0) {
+        printf(" Error: Could not open file '%s'\n", program_path);
+        return 1;
+    }
+    
+    compile_options.binary_log = 1;
+    ArduinoGen* gen = create_arduino_gen();
+    Lexer* lexer = parse_program(code, gen);
+    assemble_sketch(gen);
+    free(lexer);
+    
+    size_t length;
+    unsigned char* data = read_capture_file(capture_path, &length);
+    if (!data) {
+        printf(" Error: Could not read capture '%s'\n", capture_path);
+        free(gen);
+        return 1;
+    }
+    
+    for (size_t pos = 0; pos + LOG_RECORD_BYTES <= length;) {
+        const unsigned char* record = data + pos;
+        if (record[0] != LOG_SYNC || record[1] >= gen->log_message_count) {
+            pos++;  // Not a record (profile frame or noise): resync
+            continue;
+        }
+        
+        LogMessage* message = &gen->log_messages[record[1]];
+        short value = (short)(record[2] | record[3] << 8);
+        unsigned long now = (unsigned long)record[4] | (unsigned long)record[5] << 8 |
+                            (unsigned long)record[6] << 16 | (unsigned long)record[7] << 24;
+        
+        printf("[%6lu.%03lus] %s", now / 1000, now % 1000, message->prefix);
+        if (message->has_value) {
+            if (message->scale > 1) {
+                printf("%.1f", (double)value / message->scale);
+            } else {
+                printf("%d", value);
+            }
+        }
+        printf("%s\n", message->suffix);
+        pos += LOG_RECORD_BYTES;
+    }
+    
+    free(data);
+    free(gen);
+    return 0;
+}
+
+// Example programs showcase
+typedef struct {
+    const char* title;
+    const char* code;
+} ExampleProgram;
+
+static const ExampleProgram arduino_examples[] = {
+    { "Blinking LED",
+        "// Simple LED blink\n"
+        "turn_on 13\n"
+        "wait 1000\n"
+        "turn_off 13\n"
+        "wait 1000\n"
+        "blink 13 5\n"
+        "print \"LED demo complete!\"" },
+    { "Servo Motor Control",
+        "// Servo sweep\n"
+        "print \"Moving servo motor\"\n"
+        "move_servo 9 0\n"
+        "wait 1000\n"
+        "move_servo 9 90\n"
+        "wait 1000\n"
+        "move_servo 9 180\n"
+        "wait 1000\n"
+        "print \"Servo sweep complete!\"" },
+    { "Temperature Sensor",
         "// Temperature monitoring\n"
         "print \"Reading temperature...\"\n"
         "read_temperature 2\n"
         "wait 2000\n"
         "beep 8 500\n"
-        "print \"Temperature check done!\"", 1
-    );
-    
-    printf("\n\nExample 4: Distance Sensor\n");
-    printf("-----------------------------\n");
-    interpret_arduino_kids(
+        "print \"Temperature check done!\"" },
+    { "Distance Sensor",
         "// Ultrasonic distance sensor\n"
         "print \"Measuring distance...\"\n"
         "read_distance 7 6\n"
         "wait 1000\n"
         "beep 8 200\n"
-        "print \"Distance measured!\"", 1
-    );
-    
-    printf("\n\nExample 5: Complex Robot Behavior\n");
-    printf("------------------------------------\n");
-    interpret_arduino_kids(
+        "print \"Distance measured!\"" },
+    { "Complex Robot Behavior",
         "// Smart robot behavior\n"
         "print \"Smart robot starting!\"\n"
         "print_lcd \"Robot Active\"\n"
@@ -789,8 +2780,281 @@ void run_arduino_examples() {
         "    wait 500\n"
         "}\n"
         "print_lcd \"Mission Complete\"\n"
-        "print \"Robot program finished!\"", 1
-    );
+        "print \"Robot program finished!\"" },
+};
+
+#define EXAMPLE_COUNT (int)(sizeof(arduino_examples) / sizeof(arduino_examples[0]))
+
+void run_arduino_examples() {
+    printf(" Arduino Kids Programming Language\n");
+    printf("====================================\n");
+    printf(" Professional Educational Compiler for Resume\n");
+    printf("Converts kid-friendly commands to Arduino C++ code\n\n");
+    
+    for (int i = 0; i < EXAMPLE_COUNT; i++) {
+        char heading[128];
+        snprintf(heading, sizeof(heading), "%sExample %d: %s",
+                 i == 0 ? " " : "", i + 1, arduino_examples[i].title);
+        printf("%s%s\n", i == 0 ? "" : "\n\n", heading);
+        for (size_t dash = 0; dash < strlen(heading) + 2; dash++) putchar('-');
+        printf("\n");
+        interpret_arduino_kids(arduino_examples[i].code, 1);
+    }
+}
+
+// ============================================================================
+// LEXER BENCHMARK
+// Tokenizes large synthetic programs with the original byte-at-a-time
+// lexer, the scalar fallback and the SSE2 scanners, checks all three produce
+// the same tokens, and reports MB/s.
+// ============================================================================
+
+#define LEXER_BENCH_BYTES (4 << 20)
+
+// The lexer as it was before the SSE2 scanners: isspace() on every byte,
+// line/column updated as it goes and the whole Token cleared per call. Kept
+// only as the --bench-lexer baseline. Keyword lookup uses the current
+// get_keyword_type, so this slightly flatters the baseline.
+Token reference_next_token(Lexer* lexer) {
+    Token token;
+    memset(&token, 0, sizeof(Token));
+    
+    while (lexer->pos < lexer->length) {
+        char current = lexer->input[lexer->pos];
+        
+        if (isspace((unsigned char)current)) {
+            if (current == '\n') {
+                lexer->line++;
+                lexer->column = 1;
+            } else {
+                lexer->column++;
+            }
+            lexer->pos++;
+        } else if (current == '/' && lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '/') {
+            while (lexer->pos < lexer->length && lexer->input[lexer->pos] != '\n') lexer->pos++;
+        } else {
+            break;
+        }
+    }
+    
+    if (lexer->pos >= lexer->length) {
+        token.type = TOKEN_EOF;
+        return token;
+    }
+    
+    char current = lexer->input[lexer->pos];
+    int start = lexer->pos;
+    token.line = lexer->line;
+    token.column = lexer->column;
+    
+    if (isdigit((unsigned char)current)) {
+        while (lexer->pos < lexer->length && isdigit((unsigned char)lexer->input[lexer->pos])) {
+            lexer->pos++;
+            lexer->column++;
+        }
+        strncpy(token.value, lexer->input + start, lexer->pos - start);
+        token.number = atoi(token.value);
+        token.type = TOKEN_NUMBER;
+        return token;
+    }
+    
+    if (current == '"') {
+        lexer->pos++;
+        lexer->column++;
+        start = lexer->pos;
+        while (lexer->pos < lexer->length && lexer->input[lexer->pos] != '"') {
+            lexer->pos++;
+            lexer->column++;
+        }
+        if (lexer->pos >= lexer->length) {
+            token.type = TOKEN_ERROR;
+            return token;
+        }
+        strncpy(token.value, lexer->input + start, lexer->pos - start);
+        token.type = TOKEN_STRING;
+        lexer->pos++;
+        lexer->column++;
+        return token;
+    }
+    
+    if (isalpha((unsigned char)current) || current == '_') {
+        char lower_value[256];
+        while (lexer->pos < lexer->length &&
+               (isalnum((unsigned char)lexer->input[lexer->pos]) || lexer->input[lexer->pos] == '_')) {
+            lexer->pos++;
+            lexer->column++;
+        }
+        strncpy(token.value, lexer->input + start, lexer->pos - start);
+        strcpy(lower_value, token.value);
+        for (int i = 0; lower_value[i]; i++) lower_value[i] = tolower((unsigned char)lower_value[i]);
+        token.type = get_keyword_type(lower_value);
+        return token;
+    }
+    
+    switch (current) {
+        case '{': token.type = TOKEN_LBRACE; break;
+        case '}': token.type = TOKEN_RBRACE; break;
+        case '(': token.type = TOKEN_LPAREN; break;
+        case ')': token.type = TOKEN_RPAREN; break;
+        case ',': token.type = TOKEN_COMMA; break;
+        case ';': token.type = TOKEN_SEMICOLON; break;
+        case '<': token.type = TOKEN_LESS; break;
+        case '>': token.type = TOKEN_GREATER; break;
+        default: token.type = TOKEN_ERROR; break;
+    }
+    token.value[0] = current;
+    lexer->pos++;
+    lexer->column++;
+    return token;
+}
+
+typedef struct {
+    long tokens;
+    unsigned long checksum;     // Mixes type, line and column of every token
+    double seconds;
+} LexerRun;
+
+LexerRun time_lexer(char* input, int repeats, Token (*next_token)(Lexer*)) {
+    LexerRun run = {0, 0, 0};
+    struct timespec start, end;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < repeats; r++) {
+        Lexer* lexer = create_lexer(input);
+        Token token;
+        while ((token = next_token(lexer)).type != TOKEN_EOF) {
+            run.tokens++;
+            run.checksum = run.checksum * 31 + token.type * 7919 + token.line * 131 + token.column;
+        }
+        free(lexer);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    run.seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return run;
+}
+
+// Fill a buffer by repeating one program fragment
+char* repeat_fragment(const char* fragment) {
+    char* input = malloc(LEXER_BENCH_BYTES + 1);
+    size_t fragment_length = strlen(fragment);
+    size_t length = 0;
+    
+    while (length + fragment_length <= LEXER_BENCH_BYTES) {
+        memcpy(input + length, fragment, fragment_length);
+        length += fragment_length;
+    }
+    input[length] = '\0';
+    return input;
+}
+
+int bench_lexer(int repeats) {
+    static const struct { const char* name; const char* fragment; } inputs[] = {
+        { "comment-heavy",
+          "// The robot checks the distance in front of it and turns when too close\n"
+          "        // then it beeps twice so everyone knows what it is doing\n"
+          "        turn_on 13\n" },
+        { "string-heavy",
+          "print \"The robot is driving forward through the classroom right now!\"\n"
+          "print_lcd \"Distance check: everything looks clear ahead of the robot\"\n" },
+        { "commands",
+          "repeat 3 {\n    turn_on 13\n    beep 8 300\n    move_servo 9 45\n    wait 500\n}\n" },
+    };
+    int mismatches = 0;
+    
+    printf(" Lexer throughput (%d MB input, %d passes)\n", LEXER_BENCH_BYTES >> 20, repeats);
+    printf(" %-14s %14s %12s %12s %10s %9s %9s\n", "input", "baseline MB/s", "scalar MB/s", "SSE2 MB/s",
+           "tokens", "scalar", "SSE2");
+    
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        char* input = repeat_fragment(inputs[i].fragment);
+        double megabytes = strlen(input) * (double)repeats / (1 << 20);
+        int simd = scan_simd;
+        
+        LexerRun baseline = time_lexer(input, repeats, reference_next_token);
+        scan_simd = 0;
+        LexerRun scalar = time_lexer(input, repeats, get_next_token);
+        scan_simd = simd;
+        LexerRun vector = time_lexer(input, repeats, get_next_token);
+        
+        int mismatch = baseline.checksum != vector.checksum || scalar.checksum != vector.checksum;
+        if (mismatch) mismatches++;
+        printf(" %-14s %14.1f %12.1f %12.1f %10ld %8.2fx %8.2fx%s\n", inputs[i].name,
+               megabytes / baseline.seconds, megabytes / scalar.seconds, megabytes / vector.seconds,
+               vector.tokens / repeats, baseline.seconds / scalar.seconds, baseline.seconds / vector.seconds,
+               mismatch ? "  MISMATCH" : "");
+        free(input);
+    }
+    
+    printf(" (speedups are against the baseline, the byte-at-a-time lexer before SSE2)\n");
+    if (!scan_simd) printf(" (built without SSE2: the scalar and SSE2 columns use the same scanners)\n");
+    return mismatches > 0;
+}
+
+// ============================================================================
+// HOST BENCHMARK
+// Builds a generated sketch as a native program against the Arduino shim in
+// host/ (override with ARDUINO_HOST_DIR) and runs it on the virtual clock.
+// ============================================================================
+
+#define HOST_BUILD_DIR "host_build"
+
+int bench_program(const char* code, const char* name, int loops) {
+    const char* host_dir = getenv("ARDUINO_HOST_DIR");
+    char sketch_path[256];
+    char binary_path[256];
+    char command[1024];
+    
+    if (!host_dir) host_dir = "host";
+    
+    ArduinoGen* gen = create_arduino_gen();
+    Lexer* lexer = parse_program(code, gen);
+    assemble_sketch(gen);
+    int error_count = lexer->error_count;
+    free(lexer);
+    
+    mkdir(HOST_BUILD_DIR, 0755);
+    snprintf(sketch_path, sizeof(sketch_path), "%s/%s.ino", HOST_BUILD_DIR, name);
+    snprintf(binary_path, sizeof(binary_path), "%s/%s", HOST_BUILD_DIR, name);
+    int result = write_sketch_atomic(sketch_path, gen->output);
+    free(gen);
+    
+    if (result != 0 || error_count > 0) {
+        printf(" %s: %s\n", name, result != 0 ? "could not write sketch" : "program has errors");
+        return 1;
+    }
+    
+    snprintf(command, sizeof(command),
+             "c++ -std=c++17 -O1 -Wall -Wextra -I'%s' -include Arduino.h -x c++ '%s' -x none '%s/host_main.cpp' -o '%s'",
+             host_dir, sketch_path, host_dir, binary_path);
+    fflush(stdout);
+    if (system(command) != 0) {
+        printf(" %s: native build failed\n", name);
+        return 1;
+    }
+    
+    snprintf(command, sizeof(command), "'./%s' %d", binary_path, loops);
+    fflush(stdout);
+    if (system(command) != 0) {
+        printf(" %s: sketch crashed\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+int bench_examples(int loops) {
+    int failures = 0;
+    
+    for (int i = 0; i < EXAMPLE_COUNT; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "example_%d", i + 1);
+        printf("\n Example %d: %s\n", i + 1, arduino_examples[i].title);
+        printf("---------------------------------\n");
+        failures += bench_program(arduino_examples[i].code, name, loops) != 0;
+    }
+    
+    printf("\n %d of %d examples built and ran natively\n", EXAMPLE_COUNT - failures, EXAMPLE_COUNT);
+    return failures > 0;
 }
 
 // Simple mode for kids (hide technical details)
@@ -831,6 +3095,29 @@ void run_kid_friendly_examples() {
 
 // Main function with multiple modes
 int main(int argc, char* argv[]) {
+    // Strip code generation flags so the mode dispatch below stays positional
+    int arg_count = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) {
+            compile_options.profile = 1;
+        } else if (strcmp(argv[i], "--binary-log") == 0) {
+            compile_options.binary_log = 1;
+        } else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            compile_options.baud_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--temp-interval") == 0 && i + 1 < argc) {
+            compile_options.temp_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--distance-interval") == 0 && i + 1 < argc) {
+            compile_options.distance_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fixed-point") == 0) {
+            compile_options.fixed_point = 1;
+        } else if (strcmp(argv[i], "--motor-ramp") == 0 && i + 1 < argc) {
+            compile_options.motor_ramp_ms = atoi(argv[++i]);
+        } else {
+            argv[arg_count++] = argv[i];
+        }
+    }
+    argc = arg_count;
+    
     if (argc > 1) {
         if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
             printf(" Arduino Kids Programming Language Interpreter\n");
@@ -842,13 +3129,29 @@ int main(int argc, char* argv[]) {
             printf("   %s --dev <filename>   - Show full Arduino C++ code generation\n", argv[0]);
             printf("   %s --showcase         - Full technical demonstration\n", argv[0]);
             printf("   %s --examples         - All example programs with details\n", argv[0]);
+            printf("   %s --watch <file|dir> [-o <outdir>] - Recompile .txt programs on save\n", argv[0]);
+            printf("   %s --bench <file> [loops]   - Build the sketch natively and count API calls\n", argv[0]);
+            printf("   %s --bench-examples [loops] - Build and run every showcase example natively\n", argv[0]);
+            printf("   %s --bench-lexer [passes]   - Time the SSE2 and scalar lexer scanners\n", argv[0]);
+            printf("\n Code Generation Flags (combine with any mode above):\n");
+            printf("   --profile                         - Time every command on the robot (115200 baud)\n");
+            printf("   %s --profile-report <file> <capture> - Per-line hot spots from a serial capture\n", argv[0]);
+            printf("   --binary-log                      - Send 8-byte message records instead of text\n");
+            printf("   %s --log-decode <file> <capture>  - Turn binary log records back into messages\n", argv[0]);
+            printf("   --baud <rate>                     - Serial speed (default 9600, 115200 for binary)\n");
+            printf("   --temp-interval <ms>              - Reuse a temperature reading this long (default 2000)\n");
+            printf("   --distance-interval <ms>          - Ping each distance sensor at most this often\n");
+            printf("   --fixed-point                     - Integer-only sensor math, no float library\n");
+            printf("   --motor-ramp <ms>                 - Time for a motor to reach full speed (default 400)\n");
             printf("\n Kid-Friendly Arduino Commands:\n");
             printf("   LED Control: turn_on <pin>, turn_off <pin>, blink <pin> <times>\n");
             printf("   Sound: beep <pin> <duration>, play_tone <pin> <frequency>\n");
             printf("   Servo: move_servo <pin> <angle>\n");
+            printf("   Motors: motor <name> <speed pin> <pin> <pin>, forward/backward <name> <0-100>, stop <name>\n");
             printf("   Sensors: read_temperature <pin>, read_distance <trig> <echo>\n");
             printf("   Display: print_lcd \"message\", print \"message\"\n");
             printf("   Control: wait <ms>, repeat <times> { ... }, forever { ... }\n");
+            printf("   Behaviors: define <name> [values] { ... }, do <name> [values]\n");
             printf("\n Example Arduino Kids Program:\n");
             printf("   turn_on 13\n");
             printf("   wait 1000\n");
@@ -868,14 +3171,43 @@ int main(int argc, char* argv[]) {
             return 0;
         }
         
+        if (strcmp(argv[1], "--profile-report") == 0 && argc > 3) {
+            return report_profile(argv[2], argv[3]);
+        }
+        
+        if (strcmp(argv[1], "--log-decode") == 0 && argc > 3) {
+            return decode_binary_log(argv[2], argv[3]);
+        }
+        
+        if (strcmp(argv[1], "--bench-lexer") == 0) {
+            return bench_lexer(argc > 2 ? atoi(argv[2]) : 5);
+        }
+        
+        if (strcmp(argv[1], "--bench-examples") == 0) {
+            return bench_examples(argc > 2 ? atoi(argv[2]) : 10);
+        }
+        
+        if (strcmp(argv[1], "--bench") == 0 && argc > 2) {
+            char code[4096];
+            if (read_program_file(argv[2], code, sizeof(code)) < 0) {
+                printf(" Error: Could not open file '%s'\n", argv[2]);
+                return 1;
+            }
+            return bench_program(code, "program", argc > 3 ? atoi(argv[3]) : 10);
+        }
+        
+        if (strcmp(argv[1], "--watch") == 0 && argc > 2) {
+            const char* outdir = ".";
+            if (argc > 4 && strcmp(argv[3], "-o") == 0) {
+                outdir = argv[4];
+            }
+            return watch_and_compile(argv[2], outdir);
+        }
+        
         if (strcmp(argv[1], "--dev") == 0 && argc > 2) {
             // Developer mode - show full Arduino C++ generation
-            FILE* file = fopen(argv[2], "r");
-            if (file) {
-                char code[4096];
-                size_t bytes_read = fread(code, 1, sizeof(code) - 1, file);
-                code[bytes_read] = '\0';
-                fclose(file);
+            char code[4096];
+            if (read_program_file(argv[2], code, sizeof(code)) >= 0) {
                 interpret_arduino_kids(code, 1);  // Show technical details
             } else {
                 printf(" Error: Could not open file '%s'\n", argv[2]);
@@ -885,12 +3217,8 @@ int main(int argc, char* argv[]) {
         }
         
         // Default: kid-friendly mode for file input
-        FILE* file = fopen(argv[1], "r");
-        if (file) {
-            char code[4096];
-            size_t bytes_read = fread(code, 1, sizeof(code) - 1, file);
-            code[bytes_read] = '\0';
-            fclose(file);
+        char code[4096];
+        if (read_program_file(argv[1], code, sizeof(code)) >= 0) {
             interpret_arduino_kids(code, 0);  // Hide technical details
         } else {
             printf(" Could not find file '%s'\n", argv[1]);